@@ -134,4 +134,26 @@ cl_error cl_abi_external_write_value(const void *src, cl_addr_t address,
   return cl_g_abi->functions.external.write_value(src, address, type);
 }
 
+cl_error cl_abi_external_read_scatter(cl_memory_span_t *spans,
+                                      unsigned count)
+{
+  unsigned i;
+
+  if (!spans || !cl_g_abi)
+    return CL_ERR_PARAMETER_NULL;
+  else if (cl_g_abi->functions.external.read_scatter)
+    return cl_g_abi->functions.external.read_scatter(spans, count);
+
+  /* The frontend can't batch reads, so do them one by one */
+  for (i = 0; i < count; i++)
+  {
+    spans[i].read = spans[i].size;
+    if (cl_abi_external_read_buffer(spans[i].dest, spans[i].address,
+          spans[i].size, &spans[i].read) != CL_OK)
+      spans[i].read = 0;
+  }
+
+  return CL_OK;
+}
+
 #endif
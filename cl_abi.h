@@ -121,6 +121,19 @@ cl_error cl_abi_external_write_buffer(const void *src, cl_addr_t address,
 cl_error cl_abi_external_write_value(const void *src, cl_addr_t address,
   cl_value_type type);
 
+/**
+ * Instructs the frontend to copy several ranges of external memory into
+ *   buffers at once, ideally with a single call into the target process.
+ * Can be stubbed by leaving it NULL, in which case each range is read with
+ *   `cl_abi_external_read_buffer` instead. On Linux, `cl_dma_read_process`
+ *   can be used to implement this.
+ * @param spans The ranges to read. The `read` field of each is set to the
+ *   number of bytes successfully read.
+ * @param count The number of ranges.
+ */
+cl_error cl_abi_external_read_scatter(cl_memory_span_t *spans,
+  unsigned count);
+
 #endif
 
 typedef struct
@@ -172,6 +185,9 @@ typedef struct
       /** @see cl_abi_external_write_value */
       cl_error (*write_value)(const void *src, cl_addr_t address,
                               cl_value_type type);
+
+      /** @see cl_abi_external_read_scatter */
+      cl_error (*read_scatter)(cl_memory_span_t *spans, unsigned count);
     } external;
   } functions;
 } cl_abi_t;
@@ -28,8 +28,10 @@ cl_error cl_free_action(cl_action_t *action)
   return CL_ERR_CLIENT_RUNTIME;
 }
 
-static cl_error cl_print_counter_values(char *buffer, unsigned len)
+static cl_error cl_print_counter_values(const cl_action_t *action,
+  char *buffer, unsigned len)
 {
+  const cl_page_t *page = action->script->current_page;
   const cl_counter_t *counter;
   char counter_buffer[32];
   unsigned current_len, append_len;
@@ -38,9 +40,9 @@ static cl_error cl_print_counter_values(char *buffer, unsigned len)
   if (!buffer || len == 0)
     return CL_ERR_CLIENT_RUNTIME;
 
-  for (i = 0; i < CL_COUNTERS_SIZE; i++)
+  for (i = 0; i < page->counter_count; i++)
   {
-    counter = &script.current_page->counters[i];
+    counter = &page->counters[i];
 
     /* Get counter value to temporary buffer */
     if (counter->type == CL_MEMTYPE_FLOAT ||
@@ -64,99 +66,16 @@ static cl_error cl_print_counter_values(char *buffer, unsigned len)
   return CL_OK;
 }
 
-/**
- * @brief Returns a copy of a counter's data. Used in cases where the requested
- *   counter should not be directly mutated.
- * @param source The source type of the requested counter.
- * @param offset An address or index relevant to the source type. For example,
- *   a memory note or counter index, or a memory address.
- * @return A mutable counter, or return CL_CTR_INVALID if unavailable.
- **/
-static cl_counter_t cl_get_compare_value(cl_src_t source, cl_int64 offset)
-{
-  cl_counter_t counter;
-
-  switch (source)
-  {
-  case CL_SRCTYPE_IMMEDIATE_INT:
-    counter.type = CL_MEMTYPE_INT64;
-    cl_ctr_store(&counter, &offset, CL_MEMTYPE_INT64);
-    break;
-  case CL_SRCTYPE_IMMEDIATE_FLOAT:
-    counter.type = CL_MEMTYPE_DOUBLE;
-    cl_ctr_store(&counter, &offset, CL_MEMTYPE_DOUBLE);
-    break;
-  case CL_SRCTYPE_CURRENT_RAM:
-  case CL_SRCTYPE_PREVIOUS_RAM:
-  case CL_SRCTYPE_LAST_UNIQUE_RAM:
-  {
-    cl_memnote_t *memnote = cl_find_memnote((unsigned)offset);
-
-    if (!memnote)
-      counter.type = CL_MEMTYPE_NOT_SET;
-    else if (source == CL_SRCTYPE_CURRENT_RAM)
-      counter = memnote->current;
-    else if (source == CL_SRCTYPE_PREVIOUS_RAM)
-      counter = memnote->previous;
-    else /* if (source == CL_SRCTYPE_LAST_UNIQUE_RAM) warning silence */
-      counter = memnote->last_unique;
-
-    break;
-  }
-  case CL_SRCTYPE_COUNTER:
-    if (offset < CL_COUNTERS_SIZE && offset >= 0)
-      counter = script.current_page->counters[offset];
-    else
-      counter.type = CL_MEMTYPE_NOT_SET;
-    break;
-  case CL_SRCTYPE_ROM: /* TODO */
-  default:
-    counter.type = CL_MEMTYPE_NOT_SET;
-  }
-
-  return counter;
-}
-
-/**
- * Returns a pointer to a counter that can be mutated. Currently, this only
- *   includes the counters stored within script pages.
- * @param source The source type of the requested counter.
- * @param offset An address or index relevant to the source type.
- * @return A mutable counter, or NULL if unavailable.
- **/
-static cl_counter_t *cl_get_mutable_value(cl_src_t source, cl_int64 offset)
-{
-  switch (source)
-  {
-  case CL_SRCTYPE_COUNTER:
-    if (offset < CL_COUNTERS_SIZE && offset >= 0)
-      return &script.current_page->counters[offset];
-    else
-      return NULL;
-  case CL_SRCTYPE_IMMEDIATE_INT:
-  case CL_SRCTYPE_IMMEDIATE_FLOAT:
-  case CL_SRCTYPE_CURRENT_RAM:
-  case CL_SRCTYPE_PREVIOUS_RAM:
-  case CL_SRCTYPE_LAST_UNIQUE_RAM:
-  case CL_SRCTYPE_ROM:
-  default:
-    return NULL;
-  }
-
-  return NULL;
-}
-
 static cl_error cl_act_post_achievement(cl_action_t *action)
 {
-  cl_counter_t ach_id = cl_get_compare_value(action->arguments[0].uintval,
-                                             action->arguments[1].uintval);
+  const cl_counter_t *ach_id = action->operands[0].value;
 #if CL_HAVE_EDITOR
   cl_message(CL_MSG_INFO, "Editor mode: Achievement " CL_FU64 " unlocked.",
-    ach_id.intval.raw);
+    ach_id->intval.raw);
 #else
   char data[CL_POST_DATA_SIZE];
 
-  snprintf(data, CL_POST_DATA_SIZE, "achievement_id=" CL_FU64, ach_id.intval.raw);
+  snprintf(data, CL_POST_DATA_SIZE, "achievement_id=" CL_FU64, ach_id->intval.raw);
   cl_network_post_clint(CL_END_CLINT_ACHIEVEMENT, data, NULL, NULL);
 #endif
   /* Clear this action so we don't re-submit the achievement */
@@ -171,7 +90,7 @@ static cl_error cl_act_post_progress(cl_action_t *action)
   char data[CL_POST_DATA_SIZE];
 
   snprintf(data, CL_POST_DATA_SIZE, "ach_id=%u", key);
-  if (cl_print_counter_values(data, sizeof(data)) != CL_OK)
+  if (cl_print_counter_values(action, data, sizeof(data)) != CL_OK)
     cl_message(CL_MSG_ERROR, "Unable to allocate progress data.");
   else
     cl_message(CL_MSG_ERROR, "Unimplemented endpoint progress\n%s", data);
@@ -182,12 +101,11 @@ static cl_error cl_act_post_progress(cl_action_t *action)
 /** @todo Support optional values */
 static cl_error cl_act_post_leaderboard(cl_action_t *action)
 {
-  cl_counter_t ldb_id = cl_get_compare_value(action->arguments[0].uintval,
-                                             action->arguments[1].uintval);
+  const cl_counter_t *ldb_id = action->operands[0].value;
   char data[CL_POST_DATA_SIZE];
 
-  snprintf(data, CL_POST_DATA_SIZE, "leaderboard_id=" CL_FU64, ldb_id.intval.raw);
-  if (cl_print_counter_values(data, sizeof(data)) != CL_OK)
+  snprintf(data, CL_POST_DATA_SIZE, "leaderboard_id=" CL_FU64, ldb_id->intval.raw);
+  if (cl_print_counter_values(action, data, sizeof(data)) != CL_OK)
     cl_message(CL_MSG_ERROR, "Unable to allocate leaderboard data.");
   else
     cl_message(CL_MSG_ERROR, "Unimplemented endpoint leaderboard\n%s", data);
@@ -197,22 +115,22 @@ static cl_error cl_act_post_leaderboard(cl_action_t *action)
 
 static cl_error cl_act_compare(cl_action_t *action)
 {
-  cl_counter_t left = cl_get_compare_value(action->arguments[0].uintval, action->arguments[1].uintval);
-  cl_counter_t right = cl_get_compare_value(action->arguments[2].uintval, action->arguments[3].uintval);
+  const cl_counter_t *left = action->operands[0].value;
+  const cl_counter_t *right = action->operands[1].value;
 
-  if (left.type == CL_MEMTYPE_NOT_SET || right.type == CL_MEMTYPE_NOT_SET)
+  if (left->type == CL_MEMTYPE_NOT_SET || right->type == CL_MEMTYPE_NOT_SET)
     return cl_free_action(action);
 
   switch (action->arguments[4].intval)
   {
   case CL_COMPARE_EQUAL:
-    return cl_ctr_equal(&left, &right);
+    return cl_ctr_equal(left, right);
   case CL_COMPARE_GREATER:
-    return cl_ctr_greater(&left, &right);
+    return cl_ctr_greater(left, right);
   case CL_COMPARE_LESS:
-    return cl_ctr_lesser(&left, &right);
+    return cl_ctr_lesser(left, right);
   case CL_COMPARE_NOT_EQUAL:
-    return cl_ctr_not_equal(&left, &right);
+    return cl_ctr_not_equal(left, right);
   default:
     return cl_free_action(action);
   }
@@ -220,52 +138,47 @@ static cl_error cl_act_compare(cl_action_t *action)
 
 static cl_error cl_act_changed(cl_action_t *action)
 {
-  cl_counter_t left = cl_get_compare_value(CL_SRCTYPE_CURRENT_RAM, action->arguments[0].uintval);
-  cl_counter_t right = cl_get_compare_value(CL_SRCTYPE_PREVIOUS_RAM, action->arguments[0].uintval);
+  const cl_counter_t *left = action->operands[0].value;
+  const cl_counter_t *right = action->operands[1].value;
 
-  if (left.type == CL_MEMTYPE_NOT_SET || right.type == CL_MEMTYPE_NOT_SET)
+  if (left->type == CL_MEMTYPE_NOT_SET || right->type == CL_MEMTYPE_NOT_SET)
     return cl_free_action(action);
   else
-    return cl_ctr_not_equal(&left, &right);
+    return cl_ctr_not_equal(left, right);
 }
 
 static cl_error cl_act_bits(cl_action_t *action)
 {
-  cl_counter_t left = cl_get_compare_value(action->arguments[0].uintval, action->arguments[1].uintval);
-  cl_counter_t right = cl_get_compare_value(action->arguments[2].uintval, action->arguments[3].uintval);
+  const cl_counter_t *left = action->operands[0].value;
+  const cl_counter_t *right = action->operands[1].value;
 
-  if (left.type == CL_MEMTYPE_NOT_SET || right.type == CL_MEMTYPE_NOT_SET)
+  if (left->type == CL_MEMTYPE_NOT_SET || right->type == CL_MEMTYPE_NOT_SET)
     return cl_free_action(action);
 
   /* TODO: Not exactly what we want */
-  return (left.intval.raw & right.intval.raw) == right.intval.raw ? CL_OK : CL_ERR_CLIENT_RUNTIME;
+  return (left->intval.raw & right->intval.raw) == right->intval.raw ? CL_OK : CL_ERR_CLIENT_RUNTIME;
 }
 
 static cl_error cl_act_write(cl_action_t *action)
 {
-  cl_counter_t left = cl_get_compare_value(action->arguments[0].uintval, action->arguments[1].uintval);
-  cl_counter_t right = cl_get_compare_value(action->arguments[2].uintval, action->arguments[3].uintval);
+  const cl_counter_t *left = action->operands[0].value;
+  const cl_counter_t *right = action->operands[1].value;
 
-  if (left.type == CL_MEMTYPE_NOT_SET || right.type == CL_MEMTYPE_NOT_SET)
+  if (left->type == CL_MEMTYPE_NOT_SET || right->type == CL_MEMTYPE_NOT_SET)
     return cl_free_action(action);
   else
   {
     switch (action->arguments[0].uintval)
     {
     case CL_SRCTYPE_CURRENT_RAM:
-      return cl_write_memnote_from_key(action->arguments[1].uintval, &right);
+      return cl_write_memnote_from_key(&action->script->writes,
+        action->arguments[1].uintval, right);
     case CL_SRCTYPE_COUNTER:
-    {
-      cl_counter_t *ctr = cl_get_mutable_value(CL_SRCTYPE_COUNTER, action->arguments[1].uintval);
-      if (!ctr)
-        return CL_ERR_PARAMETER_NULL;
-      else
-        *ctr = right;
-
+      *action->operands[0].value = *right;
       return CL_OK;
-    }
     default:
-      cl_script_break(CL_TRUE, "Invalid srctype to write: %u", action->arguments[0].uintval);
+      cl_script_break(action->script, CL_TRUE,
+        "Invalid srctype to write: %u", action->arguments[0].uintval);
       return CL_ERR_PARAMETER_INVALID;
     }
   }
@@ -276,8 +189,7 @@ static cl_error cl_act_write(cl_action_t *action)
  * index that operates on itself.
  */
 #define CL_TEMPLATE_CTR_UNARY \
-  cl_counter_t *ctr = cl_get_mutable_value(CL_SRCTYPE_COUNTER, \
-                                           action->arguments[0].uintval); \
+  cl_counter_t *ctr = action->counter; \
   if (!ctr || \
       ctr->type == CL_MEMTYPE_NOT_SET) \
     return CL_ERR_PARAMETER_INVALID; \
@@ -285,16 +197,14 @@ static cl_error cl_act_write(cl_action_t *action)
 
 /**
  * A template for command actions that use one argument for a mutable counter
- * index and two for a compare value lookup.
+ * index and two for the source of the value applied to it.
  */
 #define CL_TEMPLATE_CTR_BINARY \
-  cl_counter_t *ctr = cl_get_mutable_value(CL_SRCTYPE_COUNTER, \
-                                           action->arguments[0].uintval); \
-  cl_counter_t src = cl_get_compare_value(action->arguments[1].uintval, \
-                                          action->arguments[2].uintval); \
+  cl_counter_t *ctr = action->counter; \
+  const cl_counter_t *src = action->operands[0].value; \
   if (!ctr || \
       ctr->type == CL_MEMTYPE_NOT_SET || \
-      src.type == CL_MEMTYPE_NOT_SET) \
+      src->type == CL_MEMTYPE_NOT_SET) \
     return CL_ERR_PARAMETER_INVALID; \
   else
 
@@ -302,7 +212,7 @@ static cl_error cl_act_bitwise_and(cl_action_t *action)
 {
   CL_TEMPLATE_CTR_BINARY
   {
-    return cl_ctr_and(ctr, &src);
+    return cl_ctr_and(ctr, src);
   }
 }
 
@@ -318,7 +228,7 @@ static cl_error cl_act_bitwise_or(cl_action_t *action)
 {
   CL_TEMPLATE_CTR_BINARY
   {
-    return cl_ctr_or(ctr, &src);
+    return cl_ctr_or(ctr, src);
   }
 }
 
@@ -326,7 +236,7 @@ static cl_error cl_act_bitwise_xor(cl_action_t *action)
 {
   CL_TEMPLATE_CTR_BINARY
   {
-    return cl_ctr_xor(ctr, &src);
+    return cl_ctr_xor(ctr, src);
   }
 }
 
@@ -334,7 +244,7 @@ static cl_error cl_act_set(cl_action_t *action)
 {
   CL_TEMPLATE_CTR_BINARY
   {
-    *ctr = src;
+    *ctr = *src;
     return CL_OK;
   }
 }
@@ -343,7 +253,7 @@ static cl_error cl_act_shift_left(cl_action_t *action)
 {
   CL_TEMPLATE_CTR_BINARY
   {
-    return cl_ctr_shift_left(ctr, &src);
+    return cl_ctr_shift_left(ctr, src);
   }
 }
 
@@ -351,7 +261,7 @@ static cl_error cl_act_shift_right(cl_action_t *action)
 {
   CL_TEMPLATE_CTR_BINARY
   {
-    return cl_ctr_shift_right(ctr, &src);
+    return cl_ctr_shift_right(ctr, src);
   }
 }
 
@@ -359,7 +269,7 @@ static cl_error cl_act_multiplication(cl_action_t *action)
 {
   CL_TEMPLATE_CTR_BINARY
   {
-    return cl_ctr_multiply(ctr, &src);
+    return cl_ctr_multiply(ctr, src);
   }
 }
 
@@ -367,7 +277,7 @@ static cl_error cl_act_division(cl_action_t *action)
 {
   CL_TEMPLATE_CTR_BINARY
   {
-    return cl_ctr_divide(ctr, &src);
+    return cl_ctr_divide(ctr, src);
   }
 }
 
@@ -375,7 +285,7 @@ static cl_error cl_act_addition(cl_action_t *action)
 {
   CL_TEMPLATE_CTR_BINARY
   {
-    return cl_ctr_add(ctr, &src);
+    return cl_ctr_add(ctr, src);
   }
 }
 
@@ -383,7 +293,7 @@ static cl_error cl_act_modulo(cl_action_t *action)
 {
   CL_TEMPLATE_CTR_BINARY
   {
-    return cl_ctr_modulo(ctr, &src);
+    return cl_ctr_modulo(ctr, src);
   }
 }
 
@@ -391,51 +301,569 @@ static cl_error cl_act_subtraction(cl_action_t *action)
 {
   CL_TEMPLATE_CTR_BINARY
   {
-    return cl_ctr_subtract(ctr, &src);
+    return cl_ctr_subtract(ctr, src);
   }
 }
 
+/**
+ * Copies a statistic of a memory note's recent values into a counter.
+ * Arguments are the counter index, the statistic, the memory note key and the
+ * length of the window in frames.
+ */
+static cl_error cl_act_history(cl_action_t *action)
+{
+  cl_counter_t *ctr = action->counter;
+
+  if (!ctr)
+    return CL_ERR_PARAMETER_NULL;
+  else
+    return cl_memory_history_query(ctr,
+      cl_memory_history_at(action->history),
+      (cl_history_stat)action->arguments[1].uintval);
+}
+
+/* Requests the window of recent values the action reads, and keeps its index */
+static cl_error cl_prepare_history(cl_action_t *action)
+{
+  unsigned key = (unsigned)action->arguments[2].uintval;
+  unsigned frames = (unsigned)action->arguments[3].uintval;
+  const cl_memory_history_t *history;
+  cl_error error = cl_memory_history_request(key, frames);
+
+  if (error != CL_OK)
+    return error;
+  else if (!(history = cl_memory_history_find(key, frames)))
+    return CL_ERR_CLIENT_RUNTIME;
+  action->history = (unsigned)(history - memory.histories);
+
+  return CL_OK;
+}
+
+/* Whether the window kept by a history action is the one its arguments name */
+static cl_bool cl_history_bound(const cl_action_t *action)
+{
+  const cl_memory_history_t *history = cl_memory_history_at(action->history);
+  const cl_memnote_t *note;
+
+  if (action->argument_count < 4)
+    return CL_FALSE;
+  note = cl_find_memnote((unsigned)action->arguments[2].uintval);
+
+  return history && note &&
+    history->note == (unsigned)(note - memory.notes) &&
+    history->length == action->arguments[3].uintval;
+}
+
 static cl_error cl_act_change_ctr_type(cl_action_t *action)
 {
-  cl_counter_t *ctr = cl_get_mutable_value(CL_SRCTYPE_COUNTER, action->arguments[0].uintval);
+  cl_counter_t *ctr = action->counter;
   return ctr ? cl_ctr_change_type(ctr, action->arguments[1].uintval) : CL_ERR_PARAMETER_NULL;
 }
 
+/* Whether a counter holds a floating-point value, without a function call */
+#define CL_CTR_FLOAT(a) \
+  ((a)->type == CL_MEMTYPE_FLOAT || (a)->type == CL_MEMTYPE_DOUBLE)
+
+/**
+ * Evaluates a compare action on integer values without going through the
+ * counter functions. Matches `cl_act_compare`, which only compares as floats
+ * when both sides are floats.
+ * @return CL_FALSE if the action cannot take this path.
+ */
+static cl_bool cl_fast_compare(const cl_action_t *action, cl_bool *pass)
+{
+  const cl_counter_t *left = action->operands[0].value;
+  const cl_counter_t *right = action->operands[1].value;
+
+  if (action->function != cl_act_compare || action->breakpoint ||
+      left->type == CL_MEMTYPE_NOT_SET || right->type == CL_MEMTYPE_NOT_SET ||
+      (CL_CTR_FLOAT(left) && CL_CTR_FLOAT(right)))
+    return CL_FALSE;
+
+  switch (action->arguments[4].intval)
+  {
+  case CL_COMPARE_EQUAL:
+    *pass = left->intval.i64 == right->intval.i64;
+    break;
+  case CL_COMPARE_GREATER:
+    *pass = left->intval.i64 > right->intval.i64;
+    break;
+  case CL_COMPARE_LESS:
+    *pass = left->intval.i64 < right->intval.i64;
+    break;
+  case CL_COMPARE_NOT_EQUAL:
+    *pass = left->intval.i64 != right->intval.i64;
+    break;
+  default:
+    return CL_FALSE;
+  }
+
+  return CL_TRUE;
+}
+
+/* A compare with an achievement nested under it */
+static cl_bool cl_fused_compare_post(cl_action_t *actions, cl_error *result)
+{
+  cl_bool pass;
+
+  if (!cl_fast_compare(&actions[0], &pass))
+    return CL_FALSE;
+  else if (!pass)
+  {
+    /* Failed conditions count as executions, as in cl_process_action */
+    actions[0].executions++;
+    *result = CL_OK;
+  }
+  else
+    *result = cl_process_action(&actions[1]);
+
+  return CL_TRUE;
+}
+
+/* A change check and a compare, with a counter addition nested under them */
+static cl_bool cl_fused_changed_compare_add(cl_action_t *actions,
+  cl_error *result)
+{
+  const cl_counter_t *current = actions[0].operands[0].value;
+  const cl_counter_t *previous = actions[0].operands[1].value;
+  cl_counter_t *ctr = actions[2].counter;
+  const cl_counter_t *src = actions[2].operands[0].value;
+  cl_bool pass;
+
+  if (actions[0].function != cl_act_changed || actions[0].breakpoint ||
+      actions[2].function != cl_act_addition || actions[2].breakpoint ||
+      current->type == CL_MEMTYPE_NOT_SET ||
+      previous->type == CL_MEMTYPE_NOT_SET ||
+      (CL_CTR_FLOAT(current) && CL_CTR_FLOAT(previous)) ||
+      ctr->type == CL_MEMTYPE_NOT_SET || src->type == CL_MEMTYPE_NOT_SET ||
+      CL_CTR_FLOAT(ctr) || CL_CTR_FLOAT(src) ||
+      !cl_fast_compare(&actions[1], &pass))
+    return CL_FALSE;
+
+  *result = CL_OK;
+  if (current->intval.i64 == previous->intval.i64)
+    actions[0].executions++;
+  else if (!pass)
+    actions[1].executions++;
+  else
+  {
+    /* The float value is kept alongside, as in cl_ctr_add */
+    ctr->intval.i64 += src->intval.i64;
+    ctr->floatval.fp += src->floatval.fp;
+    actions[2].executions++;
+  }
+
+  return CL_TRUE;
+}
+
 static const cl_acttype_t action_types[] =
 {
-  { CL_ACTTYPE_NO_PROCESS, CL_FALSE, 0, 0, 0, cl_act_no_process },
-  { CL_ACTTYPE_COMPARE,    CL_TRUE,  5, 5, 0, cl_act_compare },
-  { CL_ACTTYPE_CHANGED,    CL_TRUE,  1, 1, 0, cl_act_changed },
-  { CL_ACTTYPE_BITS,       CL_TRUE,  4, 4, 0, cl_act_bits },
+  { CL_ACTTYPE_NO_PROCESS, CL_FALSE, 0, 0, 0, 0, 0, 0,
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_no_process, NULL },
+  { CL_ACTTYPE_COMPARE,    CL_TRUE,  5, 5, 0, CL_ARG(0) | CL_ARG(2), 0, 0,
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_compare, NULL },
+  { CL_ACTTYPE_CHANGED,    CL_TRUE,  1, 1, 0, 0, CL_ARG(0), 0,
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_changed, NULL },
+  { CL_ACTTYPE_BITS,       CL_TRUE,  4, 4, 0, CL_ARG(0) | CL_ARG(2), 0, 0,
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_bits, NULL },
 
   /* Counter arithmetic */
-  { CL_ACTTYPE_ADDITION,       CL_FALSE, 3, 3, 0, cl_act_addition },
-  { CL_ACTTYPE_SUBTRACTION,    CL_FALSE, 3, 3, 0, cl_act_subtraction },
-  { CL_ACTTYPE_MULTIPLICATION, CL_FALSE, 3, 3, 0, cl_act_multiplication },
-  { CL_ACTTYPE_DIVISION,       CL_FALSE, 3, 3, 0, cl_act_division },
-  { CL_ACTTYPE_MODULO,         CL_FALSE, 3, 3, 0, cl_act_modulo },
-  { CL_ACTTYPE_SET,            CL_FALSE, 3, 3, 0, cl_act_set },
+  { CL_ACTTYPE_ADDITION,       CL_FALSE, 3, 3, 0, CL_ARG(1), 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_addition, NULL },
+  { CL_ACTTYPE_SUBTRACTION,    CL_FALSE, 3, 3, 0, CL_ARG(1), 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_subtraction, NULL },
+  { CL_ACTTYPE_MULTIPLICATION, CL_FALSE, 3, 3, 0, CL_ARG(1), 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_multiplication, NULL },
+  { CL_ACTTYPE_DIVISION,       CL_FALSE, 3, 3, 0, CL_ARG(1), 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_division, NULL },
+  { CL_ACTTYPE_MODULO,         CL_FALSE, 3, 3, 0, CL_ARG(1), 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_modulo, NULL },
+  { CL_ACTTYPE_SET,            CL_FALSE, 3, 3, 0, CL_ARG(1), 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_set, NULL },
 
   /* Counter bitwise arithmetic */
-  { CL_ACTTYPE_AND,         CL_FALSE, 3, 3, 0, cl_act_bitwise_and },
-  { CL_ACTTYPE_OR,          CL_FALSE, 3, 3, 0, cl_act_bitwise_or },
-  { CL_ACTTYPE_XOR,         CL_FALSE, 3, 3, 0, cl_act_bitwise_xor },
-  { CL_ACTTYPE_COMPLEMENT,  CL_FALSE, 1, 1, 0, cl_act_bitwise_complement },
-  { CL_ACTTYPE_SHIFT_LEFT,  CL_FALSE, 3, 3, 0, cl_act_shift_left },
-  { CL_ACTTYPE_SHIFT_RIGHT, CL_FALSE, 3, 3, 0, cl_act_shift_right },
+  { CL_ACTTYPE_AND,         CL_FALSE, 3, 3, 0, CL_ARG(1), 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_bitwise_and, NULL },
+  { CL_ACTTYPE_OR,          CL_FALSE, 3, 3, 0, CL_ARG(1), 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_bitwise_or, NULL },
+  { CL_ACTTYPE_XOR,         CL_FALSE, 3, 3, 0, CL_ARG(1), 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_bitwise_xor, NULL },
+  { CL_ACTTYPE_COMPLEMENT,  CL_FALSE, 1, 1, 0, 0, 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_bitwise_complement, NULL },
+  { CL_ACTTYPE_SHIFT_LEFT,  CL_FALSE, 3, 3, 0, CL_ARG(1), 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_shift_left, NULL },
+  { CL_ACTTYPE_SHIFT_RIGHT, CL_FALSE, 3, 3, 0, CL_ARG(1), 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_shift_right, NULL },
 
   /* Direct value manipulation */
-  { CL_ACTTYPE_WRITE,           CL_FALSE, 4, 4, 0, cl_act_write },
-  { CL_ACTTYPE_CHANGE_CTR_TYPE, CL_FALSE, 2, 2, 0, cl_act_change_ctr_type },
+  { CL_ACTTYPE_WRITE,           CL_FALSE, 4, 4, 0, CL_ARG(0) | CL_ARG(2), 0, 0,
+    CL_TRUE, CL_FALSE, CL_FALSE, cl_act_write, NULL },
+  { CL_ACTTYPE_CHANGE_CTR_TYPE, CL_FALSE, 2, 2, 0, 0, 0, CL_ARG(0),
+    CL_FALSE, CL_FALSE, CL_FALSE, cl_act_change_ctr_type, NULL },
+
+  /* Memory note history */
+  { CL_ACTTYPE_HISTORY, CL_FALSE, 4, 4, 0, 0, CL_ARG(2), CL_ARG(0),
+    CL_TRUE, CL_FALSE, CL_FALSE, cl_act_history, cl_prepare_history },
 
   /* Website API calls */
-  { CL_ACTTYPE_POST_ACHIEVEMENT, CL_FALSE, 2, 2,  0, cl_act_post_achievement },
-  { CL_ACTTYPE_POST_LEADERBOARD, CL_FALSE, 2, 16, 2, cl_act_post_leaderboard },
-  { CL_ACTTYPE_POST_PROGRESS,    CL_FALSE, 2, 16, 2, cl_act_post_progress },
+  { CL_ACTTYPE_POST_ACHIEVEMENT, CL_FALSE, 2, 2,  0, CL_ARG(0), 0, 0,
+    CL_FALSE, CL_FALSE, CL_TRUE, cl_act_post_achievement, NULL },
+  { CL_ACTTYPE_POST_LEADERBOARD, CL_FALSE, 2, 16, 2, CL_ARG(0), 0, 0,
+    CL_TRUE, CL_TRUE, CL_TRUE, cl_act_post_leaderboard, NULL },
+  { CL_ACTTYPE_POST_PROGRESS,    CL_FALSE, 2, 16, 2, 0, 0, 0,
+    CL_TRUE, CL_TRUE, CL_TRUE, cl_act_post_progress, NULL },
+
+  { 0, CL_FALSE, 0, 0, 0, 0, 0, 0, CL_FALSE, CL_FALSE, CL_FALSE, NULL, NULL }
+};
+
+typedef struct
+{
+  /* The types of the conditions in the chain, then of the nested action */
+  cl_action_id types[3];
+
+  /* The number of actions, including the nested one */
+  unsigned count;
 
-  { 0, CL_FALSE, 0, 0, 0, NULL }
+  cl_fused_func_t function;
+} cl_fusion_t;
+
+/* The sequences of actions that have fused handlers */
+static const cl_fusion_t fusions[] =
+{
+  { { CL_ACTTYPE_COMPARE, CL_ACTTYPE_POST_ACHIEVEMENT }, 2,
+    cl_fused_compare_post },
+  { { CL_ACTTYPE_CHANGED, CL_ACTTYPE_COMPARE, CL_ACTTYPE_ADDITION }, 3,
+    cl_fused_changed_compare_add },
+
+  { { 0 }, 0, NULL }
 };
 
+cl_fused_func_t cl_action_fuse(const cl_action_t *actions, unsigned count)
+{
+  const cl_fusion_t *fusion;
+  unsigned i;
+
+  for (fusion = &fusions[0]; fusion->function; fusion++)
+  {
+    if (fusion->count != count)
+      continue;
+    for (i = 0; i < count && actions[i].type == fusion->types[i]; i++);
+    if (i == count)
+      return fusion->function;
+  }
+
+  return NULL;
+}
+
+static const cl_acttype_t *cl_find_acttype(cl_action_id id)
+{
+  const cl_acttype_t *acttype = &action_types[0];
+
+  while (acttype->function)
+  {
+    if (acttype->id == id)
+      return acttype;
+    acttype++;
+  }
+
+  return NULL;
+}
+
+unsigned cl_action_note_keys(const cl_action_t *action, unsigned *keys)
+{
+  const cl_acttype_t *acttype = cl_find_acttype(action->type);
+  unsigned count = 0;
+  unsigned i;
+
+  if (!acttype || !action->arguments)
+    return 0;
+  for (i = 0; i < action->argument_count && i < sizeof(unsigned) * 8 &&
+       count < CL_ACTION_OPERANDS; i++)
+  {
+    if ((acttype->source_args & CL_ARG(i)) && i + 1 < action->argument_count)
+    {
+      switch (action->arguments[i].uintval)
+      {
+      case CL_SRCTYPE_CURRENT_RAM:
+      case CL_SRCTYPE_PREVIOUS_RAM:
+      case CL_SRCTYPE_LAST_UNIQUE_RAM:
+        keys[count++] = (unsigned)action->arguments[i + 1].uintval;
+        break;
+      default:
+        break;
+      }
+    }
+    else if (acttype->note_args & CL_ARG(i))
+      keys[count++] = (unsigned)action->arguments[i].uintval;
+  }
+
+  return count;
+}
+
+unsigned cl_action_counter_count(const cl_action_t *action)
+{
+  const cl_acttype_t *acttype = cl_find_acttype(action->type);
+  unsigned count = 0;
+  unsigned i;
+
+  if (!acttype || !action->arguments)
+    return 0;
+  for (i = 0; i < action->argument_count && i < sizeof(unsigned) * 8; i++)
+  {
+    cl_uint64 index;
+
+    if ((acttype->source_args & CL_ARG(i)) && i + 1 < action->argument_count &&
+        action->arguments[i].uintval == CL_SRCTYPE_COUNTER)
+      index = action->arguments[i + 1].uintval;
+    else if (acttype->counter_args & CL_ARG(i))
+      index = action->arguments[i].uintval;
+    else
+      continue;
+    if (index < CL_COUNTERS_MAX && index + 1 > count)
+      count = (unsigned)index + 1;
+  }
+
+  return count;
+}
+
+cl_bool cl_action_every_frame(const cl_action_t *action)
+{
+  const cl_acttype_t *acttype = cl_find_acttype(action->type);
+
+  return acttype ? acttype->every_frame : CL_FALSE;
+}
+
+/* Marks the memory notes an action reads so they are updated every frame */
+static void cl_action_reference_notes(const cl_action_t *action)
+{
+  const cl_acttype_t *acttype = cl_find_acttype(action->type);
+  unsigned keys[CL_ACTION_OPERANDS];
+  unsigned count = cl_action_note_keys(action, keys);
+  unsigned i;
+
+  for (i = 0; i < count; i++)
+    cl_memory_reference_note(keys[i]);
+  if (acttype && acttype->posts)
+    cl_memory_reference_flag(CL_MEMFLAG_RICH);
+}
+
+/**
+ * Resolves one source type and offset pair of an action's arguments to the
+ * value it refers to.
+ */
+static cl_error cl_operand_bind(cl_operand_t *operand, cl_src_t source,
+  cl_int64 offset, cl_counter_t *counters, unsigned counter_count)
+{
+  operand->value = NULL;
+  switch (source)
+  {
+  case CL_SRCTYPE_IMMEDIATE_INT:
+    operand->immediate.type = CL_MEMTYPE_INT64;
+    cl_ctr_store(&operand->immediate, &offset, CL_MEMTYPE_INT64);
+    operand->value = &operand->immediate;
+    break;
+  case CL_SRCTYPE_IMMEDIATE_FLOAT:
+    operand->immediate.type = CL_MEMTYPE_DOUBLE;
+    cl_ctr_store(&operand->immediate, &offset, CL_MEMTYPE_DOUBLE);
+    operand->value = &operand->immediate;
+    break;
+  case CL_SRCTYPE_CURRENT_RAM:
+  case CL_SRCTYPE_PREVIOUS_RAM:
+  case CL_SRCTYPE_LAST_UNIQUE_RAM:
+    operand->value = cl_memory_note_value((unsigned)offset, source);
+    if (!operand->value)
+      cl_message(CL_MSG_ERROR, "Action uses missing memory note %u.",
+        (unsigned)offset);
+    break;
+  case CL_SRCTYPE_COUNTER:
+    if (offset >= 0 && offset < (cl_int64)counter_count)
+      operand->value = &counters[offset];
+    else
+      cl_message(CL_MSG_ERROR, "Action uses missing counter %u.",
+        (unsigned)offset);
+    break;
+  case CL_SRCTYPE_ROM: /* TODO */
+  default:
+    break;
+  }
+
+  return operand->value ? CL_OK : CL_ERR_PARAMETER_INVALID;
+}
+
+/**
+ * Resolves a source type and offset pair to an immediate value.
+ * @return CL_FALSE if the source is not an immediate.
+ */
+static cl_bool cl_operand_immediate(cl_operand_t *operand,
+  const cl_arg_t *args)
+{
+  switch (args[0].uintval)
+  {
+  case CL_SRCTYPE_IMMEDIATE_INT:
+  case CL_SRCTYPE_IMMEDIATE_FLOAT:
+    return cl_operand_bind(operand, (cl_src_t)args[0].uintval,
+      (cl_int64)args[1].uintval, NULL, 0) == CL_OK;
+  default:
+    return CL_FALSE;
+  }
+}
+
+cl_bool cl_action_constant(const cl_action_t *action, cl_bool *pass)
+{
+  cl_operand_t left, right;
+  const cl_counter_t *l = &left.immediate;
+  const cl_counter_t *r = &right.immediate;
+
+  if (!action->arguments || !action->if_type)
+    return CL_FALSE;
+  else if (action->type == CL_ACTTYPE_COMPARE)
+  {
+    if (!cl_operand_immediate(&left, &action->arguments[0]) ||
+        !cl_operand_immediate(&right, &action->arguments[2]))
+      return CL_FALSE;
+
+    /* Invalid comparisons are left to disable the action when run */
+    switch (action->arguments[4].intval)
+    {
+    case CL_COMPARE_EQUAL:
+      *pass = cl_ctr_equal(l, r);
+      break;
+    case CL_COMPARE_GREATER:
+      *pass = cl_ctr_greater(l, r);
+      break;
+    case CL_COMPARE_LESS:
+      *pass = cl_ctr_lesser(l, r);
+      break;
+    case CL_COMPARE_NOT_EQUAL:
+      *pass = cl_ctr_not_equal(l, r);
+      break;
+    default:
+      return CL_FALSE;
+    }
+  }
+  else if (action->type == CL_ACTTYPE_BITS)
+  {
+    if (!cl_operand_immediate(&left, &action->arguments[0]) ||
+        !cl_operand_immediate(&right, &action->arguments[2]))
+      return CL_FALSE;
+
+    /* Matches `cl_act_bits`, which returns CL_OK when the bits are set */
+    *pass = (l->intval.raw & r->intval.raw) != r->intval.raw ?
+      CL_TRUE : CL_FALSE;
+  }
+  else
+    return CL_FALSE;
+
+  return CL_TRUE;
+}
+
+cl_bool cl_action_invariant(const cl_action_t *action, unsigned *counter)
+{
+  cl_operand_t value;
+
+  if (action->type != CL_ACTTYPE_SET || !action->arguments ||
+      action->argument_count < 3 ||
+      action->arguments[0].uintval >= CL_COUNTERS_MAX ||
+      !cl_operand_immediate(&value, &action->arguments[1]))
+    return CL_FALSE;
+  *counter = (unsigned)action->arguments[0].uintval;
+
+  return CL_TRUE;
+}
+
+cl_bool cl_action_uses_counter(const cl_action_t *action, unsigned counter,
+  cl_bool *modifies)
+{
+  const cl_acttype_t *acttype = cl_find_acttype(action->type);
+  cl_bool uses = CL_FALSE;
+  unsigned i;
+
+  *modifies = CL_FALSE;
+  if (!acttype || !action->arguments)
+    return CL_FALSE;
+
+  else if (acttype->all_counters)
+    return CL_TRUE;
+
+  for (i = 0; i < action->argument_count && i < sizeof(unsigned) * 8; i++)
+  {
+    if ((acttype->source_args & CL_ARG(i)) && i + 1 < action->argument_count)
+    {
+      if (action->arguments[i].uintval == CL_SRCTYPE_COUNTER &&
+          action->arguments[i + 1].uintval == counter)
+      {
+        uses = CL_TRUE;
+
+        /* The first source of a write is where the value is written to */
+        if (action->type == CL_ACTTYPE_WRITE && i == 0)
+          *modifies = CL_TRUE;
+      }
+    }
+    else if ((acttype->counter_args & CL_ARG(i)) &&
+             action->arguments[i].uintval == counter)
+    {
+      uses = CL_TRUE;
+      *modifies = CL_TRUE;
+    }
+  }
+
+  return uses;
+}
+
+cl_error cl_action_bind(cl_action_t *action, cl_counter_t *counters,
+  unsigned counter_count)
+{
+  const cl_acttype_t *acttype = cl_find_acttype(action->type);
+  cl_error error = CL_OK;
+  unsigned operand = 0;
+  unsigned i;
+
+  if (!acttype || !action->arguments)
+    return CL_ERR_PARAMETER_INVALID;
+
+  action->counter = NULL;
+  for (i = 0; i < action->argument_count && i < sizeof(unsigned) * 8; i++)
+  {
+    cl_uint64 arg = action->arguments[i].uintval;
+
+    if ((acttype->source_args & CL_ARG(i)) && i + 1 < action->argument_count)
+    {
+      if (operand >= CL_ACTION_OPERANDS ||
+          cl_operand_bind(&action->operands[operand++], (cl_src_t)arg,
+            (cl_int64)action->arguments[i + 1].uintval,
+            counters, counter_count) != CL_OK)
+        error = CL_ERR_PARAMETER_INVALID;
+    }
+    else if (acttype->note_args & CL_ARG(i))
+    {
+      if (operand + 2 > CL_ACTION_OPERANDS ||
+          cl_operand_bind(&action->operands[operand++], CL_SRCTYPE_CURRENT_RAM,
+            (cl_int64)arg, counters, counter_count) != CL_OK ||
+          cl_operand_bind(&action->operands[operand++], CL_SRCTYPE_PREVIOUS_RAM,
+            (cl_int64)arg, counters, counter_count) != CL_OK)
+        error = CL_ERR_PARAMETER_INVALID;
+    }
+    else if (acttype->counter_args & CL_ARG(i))
+    {
+      if (arg < counter_count)
+        action->counter = &counters[arg];
+      else
+      {
+        cl_message(CL_MSG_ERROR, "Action uses missing counter %u.",
+          (unsigned)arg);
+        error = CL_ERR_PARAMETER_INVALID;
+      }
+    }
+  }
+  if (action->type == CL_ACTTYPE_HISTORY && !cl_history_bound(action))
+    error = CL_ERR_PARAMETER_INVALID;
+
+  /* Disable the action rather than have it fail every frame */
+  action->function = error == CL_OK ? acttype->function : cl_act_no_process;
+
+  return error;
+}
+
 cl_error cl_init_action(cl_action_t *action)
 {
   const cl_acttype_t *acttype = &action_types[0];
@@ -457,10 +885,14 @@ cl_error cl_init_action(cl_action_t *action)
         cl_message(CL_MSG_ERROR, "Action modulo_after_minimum error: %u % %u\n",
                action->argument_count - acttype->minimum_args,
                acttype->modulo_after_minimum);
+      else if (acttype->prepare && acttype->prepare(action) != CL_OK)
+        cl_message(CL_MSG_ERROR, "Action %u failed to prepare\n",
+               action->type);
       else
       {
         action->if_type = acttype->if_type;
         action->function = acttype->function;
+        cl_action_reference_notes(action);
 
         return CL_OK;
       }
@@ -480,12 +912,12 @@ cl_error cl_process_action(cl_action_t *action)
   cl_error result;
 
   if (!action)
-    cl_script_break(CL_TRUE, "Attempted to process a NULL action.");
+    cl_message(CL_MSG_ERROR, "Attempted to process a NULL action.");
   else if (!action->function)
-    cl_script_break(CL_TRUE, "Attempted to process an action with NULL "
-      "implementation (action type %04X).", action->type);
+    cl_script_break(action->script, CL_TRUE, "Attempted to process an action "
+      "with NULL implementation (action type %04X).", action->type);
   else if (action->breakpoint)
-    cl_script_break(CL_FALSE, "User-defined breakpoint.");
+    cl_script_break(action->script, CL_FALSE, "User-defined breakpoint.");
   else
   {
     result = action->function(action);
@@ -1,6 +1,7 @@
 #ifndef CL_ACTION_H
 #define CL_ACTION_H
 
+#include "cl_profile.h"
 #include "cl_types.h"
 
 typedef enum
@@ -39,11 +40,33 @@ typedef enum
 
   CL_ACTTYPE_ELSE,
 
+  /* Memory note history */
+  CL_ACTTYPE_HISTORY,
+
   CL_ACTTYPE_SIZE
 } cl_action_id;
 
 struct cl_action_t;
 
+/* The most values an action reads through its operands */
+#define CL_ACTION_OPERANDS 2
+
+/**
+ * A value read by an action, resolved when the script is loaded so it does
+ * not need to be looked up each frame.
+ */
+typedef struct
+{
+  /**
+   * The value itself. Points to a memory note value, a page counter, or the
+   * immediate value below.
+   */
+  cl_counter_t *value;
+
+  /* Storage for an immediate value from the action's arguments */
+  cl_counter_t immediate;
+} cl_operand_t;
+
 typedef struct cl_action_t
 {
   cl_arg_t *arguments;
@@ -55,11 +78,37 @@ typedef struct cl_action_t
   unsigned indentation;
   cl_action_id type;
 
+  /* The values the action reads, in the order of its arguments */
+  cl_operand_t operands[CL_ACTION_OPERANDS];
+
+  /* The page counter the action modifies, if any */
+  cl_counter_t *counter;
+
+  /**
+   * For history actions, the index of the window of recent values they read.
+   * See `cl_memory_history_at`.
+   */
+  unsigned history;
+
+  /* The script the action belongs to */
+  struct cl_script_t *script;
+
+#if CL_HAVE_PROFILER
+  /**
+   * Time spent running the action. The time of a fused step is counted
+   * towards its first action.
+   */
+  cl_profile_t profile;
+#endif
+
   /* TODO: Double-link actions together so the editor can easily insert new lines */
   struct cl_action_t *prev_action;
   struct cl_action_t *next_action;
 } cl_action_t;
 
+/* The bit for an argument index in the argument masks of an action type */
+#define CL_ARG(a) (1U << (a))
+
 typedef struct
 {
   cl_action_id id;
@@ -76,15 +125,142 @@ typedef struct
   /* The number of arguments used to store each optional */
   unsigned modulo_after_minimum;
 
+  /**
+   * The arguments holding a source type followed by its offset, as a mask of
+   * `CL_ARG` bits. Used to find which memory notes an action reads.
+   */
+  unsigned source_args;
+
+  /**
+   * The arguments holding a memory note key, as a mask of `CL_ARG` bits. The
+   * current and previous values of the note are bound as operands.
+   */
+  unsigned note_args;
+
+  /**
+   * The arguments holding the index of a page counter the action modifies,
+   * as a mask of `CL_ARG` bits.
+   */
+  unsigned counter_args;
+
+  /**
+   * Whether the action must run every frame, even if nothing it reads has
+   * changed, because its result depends on time or it has effects outside
+   * of its page.
+   */
+  cl_bool every_frame;
+
+  /**
+   * Whether the action reads every counter of its page, such as website
+   * calls that send all of their values.
+   */
+  cl_bool all_counters;
+
+  /**
+   * Whether the action posts to the website, which sends the current value
+   * of every rich presence note along with it.
+   */
+  cl_bool posts;
+
   /* The function of the action */
   cl_error (*function)(cl_action_t*);
+
+  /**
+   * A function run once when the action is loaded, after its arguments are
+   * read, or NULL if the action needs no setup.
+   */
+  cl_error (*prepare)(cl_action_t*);
 } cl_acttype_t;
 
 cl_error cl_free_action(cl_action_t *action);
 
-/* Assign the correct function pointer for the type of action */
+/**
+ * Assign the correct function pointer for the type of action. The arguments of
+ * the action must already be loaded.
+ */
 cl_error cl_init_action(cl_action_t *action);
 
+/**
+ * Resolves the operands of an action to the values they refer to. Actions
+ * that refer to a missing memory note or counter are reported and disabled.
+ * Must be called again if the memory notes are reallocated.
+ * @param action The action, already initialized with `cl_init_action`.
+ * @param counters The counters of the page the action belongs to.
+ * @param counter_count The number of counters in the page.
+ * @return CL_OK on success, or an error code if the action was disabled.
+ */
+cl_error cl_action_bind(cl_action_t *action, cl_counter_t *counters,
+  unsigned counter_count);
+
+/**
+ * Finds the keys of the memory notes an action reads.
+ * @param action The action, already initialized with `cl_init_action`.
+ * @param keys An array of at least `CL_ACTION_OPERANDS` keys to fill.
+ * @return The number of keys found.
+ */
+unsigned cl_action_note_keys(const cl_action_t *action, unsigned *keys);
+
+/**
+ * Returns the number of page counters an action needs, which is one past the
+ * highest counter index it refers to. Indices of `CL_COUNTERS_MAX` or more
+ * are ignored, and cause the action to be disabled when it is bound.
+ */
+unsigned cl_action_counter_count(const cl_action_t *action);
+
+/**
+ * Returns whether an action must run every frame regardless of whether the
+ * values it reads have changed.
+ */
+cl_bool cl_action_every_frame(const cl_action_t *action);
+
+/**
+ * Works out the result of a condition whose operands are all immediate
+ * values, so it is the same every frame.
+ * @param action The action, already initialized with `cl_init_action`.
+ * @param pass Set to whether the condition passes.
+ * @return CL_TRUE if the result is constant, or CL_FALSE if it depends on
+ *   memory or counters, or the action is not a condition.
+ */
+cl_bool cl_action_constant(const cl_action_t *action, cl_bool *pass);
+
+/**
+ * Returns whether an action always leaves the same value in the counter it
+ * modifies, regardless of what the counter held before.
+ * @param action The action, already initialized with `cl_init_action`.
+ * @param counter Set to the index of the counter.
+ */
+cl_bool cl_action_invariant(const cl_action_t *action, unsigned *counter);
+
+/**
+ * Returns whether an action reads or modifies a page counter.
+ * @param action The action, already initialized with `cl_init_action`.
+ * @param counter The index of the counter.
+ * @param modifies Set to whether the action modifies the counter.
+ */
+cl_bool cl_action_uses_counter(const cl_action_t *action, unsigned counter,
+  cl_bool *modifies);
+
+/**
+ * A handler for a chain of conditions and the single action nested under
+ * them, run as one step. Fused handlers take fast paths for integer values
+ * and leave anything else to the individual actions.
+ * @param actions The conditions of the chain, followed by the nested action.
+ * @param result Set to the result of the nested action, or CL_OK if it did
+ *   not run.
+ * @return CL_TRUE if the actions were run, or CL_FALSE if they must be run
+ *   one at a time as usual.
+ */
+typedef cl_bool (*cl_fused_func_t)(cl_action_t *actions, cl_error *result);
+
+/**
+ * Finds a fused handler for a chain of conditions and the single action
+ * nested under them.
+ * @param actions The conditions of the chain, followed by the nested action.
+ * @param count The number of actions, including the nested one.
+ * @return The fused handler, or NULL if there is none for these actions.
+ */
+cl_fused_func_t cl_action_fuse(const cl_action_t *actions, unsigned count);
+
 /* Run the function and return CL_OK if succeeded. */
 cl_error cl_process_action(cl_action_t *action);
 
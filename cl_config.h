@@ -136,6 +136,15 @@ typedef enum
 #define CL_HAVE_MD5 1
 #endif
 
+#ifndef CL_HAVE_PROFILER
+/**
+ * Whether or not to time each action and page of a script as it runs. The
+ * results can be read with `cl_script_profile`, and are shown in the Classics
+ * Live Editor if it is included.
+ */
+#define CL_HAVE_PROFILER 0
+#endif
+
 #ifndef CL_HAVE_SSL
 /**
  * Whether or not the networking callbacks in this implementation support HTTPS.
@@ -169,6 +178,14 @@ typedef enum
  */
 #define CL_SEARCH_BUCKET_SIZE CL_MB(128)
 #endif
+
+#ifndef CL_EXTERNAL_READ_GAP
+/**
+ * The largest gap, in bytes, between two values read from the external
+ * process in the same frame for them to still be read as one range.
+ */
+#define CL_EXTERNAL_READ_GAP 64
+#endif
 #endif
 
 #ifndef CL_SEARCH_CHUNK_SIZE
@@ -182,6 +199,58 @@ typedef enum
 #define CL_SEARCH_CHUNK_SIZE CL_KB(4)
 #endif
 
+#ifndef CL_MEMORY_DIFF_BLOCK_SIZE
+/**
+ * The number of bytes compared at a time when diffing memory snapshots.
+ * Blocks that are equal are skipped without looking at individual bytes.
+ */
+#define CL_MEMORY_DIFF_BLOCK_SIZE 64
+#endif
+
+#ifndef CL_MEMORY_WRITE_RUN_SIZE
+/**
+ * The largest number of bytes that queued memory note writes to adjacent
+ * addresses can be merged into. Writes that overlap are always merged, so a
+ * run may only exceed this when they do.
+ */
+#define CL_MEMORY_WRITE_RUN_SIZE 256
+#endif
+
+#ifndef CL_POINTERSEARCH_BLOCK_SIZE
+/**
+ * The number of pointer search results to store per allocated block.
+ */
+#define CL_POINTERSEARCH_BLOCK_SIZE 4096
+#endif
+
+#ifndef CL_POINTERSEARCH_SPILL_SIZE
+/**
+ * The amount of memory pointer search results may use before further blocks
+ * are moved to a temporary file. 0 keeps all results in memory.
+ */
+#if CL_HAVE_FILESYSTEM
+#define CL_POINTERSEARCH_SPILL_SIZE CL_MB(256)
+#else
+#define CL_POINTERSEARCH_SPILL_SIZE 0
+#endif
+#endif
+
+#ifndef CL_COUNTERS_MAX
+/**
+ * The largest number of counters a script page can use. Actions that refer
+ * to a counter past this are disabled when the script is loaded.
+ */
+#define CL_COUNTERS_MAX 1024
+#endif
+
+#ifndef CL_MEMORY_HISTORY_MAX
+/**
+ * The longest window of recent values, in frames, that can be kept for a
+ * memory note.
+ */
+#define CL_MEMORY_HISTORY_MAX 3600
+#endif
+
 #ifndef CL_URL_HOSTNAME
 /**
  * The full hostname for the CL website.
@@ -1,8 +1,34 @@
+/**
+ * Anonymous mappings are not part of strict ANSI/POSIX builds, and reading
+ * another process's memory is a GNU extension
+ */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+  #define _GNU_SOURCE
+#endif
+
 #include "cl_dma.h"
 
+#include "cl_common.h"
 #include "cl_types.h"
 
 #include <stdlib.h>
+#if CL_HAVE_FILESYSTEM
+  #include <stdio.h>
+#endif
+
+#if CL_HOST_PLATFORM == _CL_PLATFORM_LINUX
+  #include <sys/mman.h>
+  #if CL_EXTERNAL_MEMORY
+    #include <sys/uio.h>
+  #endif
+  #if CL_HAVE_FILESYSTEM
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+  #endif
+#elif CL_HOST_PLATFORM == _CL_PLATFORM_WINDOWS
+  #include <windows.h>
+#endif
 
 void *cl_dma_alloc(unsigned size, unsigned zero)
 {
@@ -16,3 +42,155 @@ void cl_dma_free(void *address)
 {
   free(address);
 }
+
+void *cl_dma_map(cl_addr_t size)
+{
+#if CL_HOST_PLATFORM == _CL_PLATFORM_LINUX
+  void *p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (p == CL_ADDRESS_INVALID)
+    return NULL;
+  else
+    return p;
+#elif CL_HOST_PLATFORM == _CL_PLATFORM_WINDOWS
+  return VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+  return calloc(1, size);
+#endif
+}
+
+void cl_dma_unmap(void *address, cl_addr_t size)
+{
+#if CL_HOST_PLATFORM == _CL_PLATFORM_LINUX
+  munmap(address, size);
+#elif CL_HOST_PLATFORM == _CL_PLATFORM_WINDOWS
+  CL_UNUSED(size);
+  VirtualFree(address, 0, MEM_RELEASE);
+#else
+  CL_UNUSED(size);
+  free(address);
+#endif
+}
+
+#if CL_EXTERNAL_MEMORY && CL_HOST_PLATFORM == _CL_PLATFORM_LINUX
+
+/* The most ranges given to a single process_vm_readv call */
+#define CL_DMA_IOV_MAX 1024
+
+cl_error cl_dma_read_process(long pid, cl_memory_span_t *spans,
+  unsigned count)
+{
+  struct iovec local[CL_DMA_IOV_MAX];
+  struct iovec remote[CL_DMA_IOV_MAX];
+  unsigned i = 0;
+
+  if (!spans)
+    return CL_ERR_PARAMETER_NULL;
+
+  while (i < count)
+  {
+    unsigned batch = count - i < CL_DMA_IOV_MAX ? count - i : CL_DMA_IOV_MAX;
+    ssize_t total;
+    unsigned j;
+
+    for (j = 0; j < batch; j++)
+    {
+      local[j].iov_base = spans[i + j].dest;
+      local[j].iov_len = spans[i + j].size;
+      remote[j].iov_base = (void*)(size_t)spans[i + j].address;
+      remote[j].iov_len = spans[i + j].size;
+      spans[i + j].read = 0;
+    }
+    total = process_vm_readv((pid_t)pid, local, batch, remote, batch, 0);
+
+    /* Nothing could be read, so the first range must be invalid */
+    if (total < 0)
+    {
+      i++;
+      continue;
+    }
+
+    /**
+     * Reads stop at the first range that can't be read in full, so retry
+     * from the range after it.
+     */
+    for (j = 0; j < batch; j++)
+    {
+      spans[i + j].read = (size_t)total < spans[i + j].size ?
+        (unsigned)total : spans[i + j].size;
+      total -= spans[i + j].read;
+      if (spans[i + j].read < spans[i + j].size)
+        break;
+    }
+    i += j < batch ? j + 1 : batch;
+  }
+
+  return CL_OK;
+}
+
+#endif
+
+#if CL_HAVE_FILESYSTEM
+const void *cl_dma_map_file(const char *path, cl_addr_t *size)
+{
+#if CL_HOST_PLATFORM == _CL_PLATFORM_LINUX
+  struct stat st;
+  void *p;
+  int fd;
+
+  if (!path || !size)
+    return NULL;
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  else if (fstat(fd, &st) != 0 || st.st_size <= 0)
+  {
+    close(fd);
+    return NULL;
+  }
+  p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == CL_ADDRESS_INVALID)
+    return NULL;
+  *size = (cl_addr_t)st.st_size;
+
+  return p;
+#else
+  FILE *file;
+  void *p = NULL;
+  long length;
+
+  if (!path || !size)
+    return NULL;
+  file = fopen(path, "rb");
+  if (!file)
+    return NULL;
+  if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) > 0 &&
+      fseek(file, 0, SEEK_SET) == 0 && (p = malloc((size_t)length)) != NULL)
+  {
+    if (fread(p, 1, (size_t)length, file) == (size_t)length)
+      *size = (cl_addr_t)length;
+    else
+    {
+      free(p);
+      p = NULL;
+    }
+  }
+  fclose(file);
+
+  return p;
+#endif
+}
+
+void cl_dma_unmap_file(const void *address, cl_addr_t size)
+{
+  if (!address)
+    return;
+#if CL_HOST_PLATFORM == _CL_PLATFORM_LINUX
+  munmap((void*)address, size);
+#else
+  CL_UNUSED(size);
+  free((void*)address);
+#endif
+}
+#endif
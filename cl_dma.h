@@ -1,8 +1,59 @@
 #ifndef CL_DMA_H
 #define CL_DMA_H
 
+#include "cl_types.h"
+
 void *cl_dma_alloc(unsigned size, unsigned zero);
 
 void cl_dma_free(void *address);
 
+/**
+ * Allocate a chunk of page-aligned, zero-filled memory. Large allocations
+ * are mapped directly from the OS where possible, so they are not committed
+ * until used and are returned to the OS immediately when unmapped.
+ * @param size The number of bytes to allocate
+ * @return A pointer to the bytes, or NULL
+ */
+void *cl_dma_map(cl_addr_t size);
+
+/**
+ * Free a chunk of memory allocated by `cl_dma_map`.
+ * @param address The pointer to free
+ * @param size The number of bytes to deallocate
+ */
+void cl_dma_unmap(void *address, cl_addr_t size);
+
+#if CL_EXTERNAL_MEMORY && CL_HOST_PLATFORM == _CL_PLATFORM_LINUX
+/**
+ * Read several ranges of another process's memory with as few system calls
+ * as possible. Intended as an implementation of the `read_scatter` ABI
+ * function for frontends targeting a Linux process.
+ * @param pid The process ID of the target process
+ * @param spans The ranges to read. The `read` field of each is set to the
+ *   number of bytes successfully read.
+ * @param count The number of ranges
+ * @return CL_OK, even if some ranges could not be read
+ */
+cl_error cl_dma_read_process(long pid, cl_memory_span_t *spans,
+  unsigned count);
+#endif
+
+#if CL_HAVE_FILESYSTEM
+/**
+ * Map the contents of a file into memory as read-only. Files are mapped
+ * directly where possible, or read into memory otherwise.
+ * @param path The path of the file to map
+ * @param size A pointer to receive the size of the file, in bytes
+ * @return A pointer to the contents, or NULL if the file could not be read
+ */
+const void *cl_dma_map_file(const char *path, cl_addr_t *size);
+
+/**
+ * Free a file mapping created by `cl_dma_map_file`.
+ * @param address The pointer to free
+ * @param size The size of the file, in bytes
+ */
+void cl_dma_unmap_file(const void *address, cl_addr_t size);
+#endif
+
 #endif
@@ -67,6 +67,7 @@ static const cl_json_key_map_t cl_json_key_map[] =
 {
   { CL_JSON_KEY_ACHIEVEMENTS,   "achievements"   },
   { CL_JSON_KEY_ADDRESS,        "address"        },
+  { CL_JSON_KEY_BINARY_SCRIPT,  "binary_script"  },
   { CL_JSON_KEY_DESCRIPTION,    "description"    },
   { CL_JSON_KEY_DETAILS,        "details"        },
   { CL_JSON_KEY_ENDIANNESS,     "endianness"     },
@@ -465,6 +466,10 @@ static int cl_json_string(void *userdata, const char *string, size_t length)
     case CL_JSON_TYPE_STRING:
       cl_json_strcpy(ud->data, ud->size, string, length);
       break;
+    case CL_JSON_TYPE_SPAN:
+      ((cl_json_span_t*)ud->data)->string = string;
+      ((cl_json_span_t*)ud->data)->length = (unsigned)length;
+      break;
     default:
       return 1;
     }
@@ -7,6 +7,7 @@ typedef enum
 
   CL_JSON_KEY_ACHIEVEMENTS,
   CL_JSON_KEY_ADDRESS,
+  CL_JSON_KEY_BINARY_SCRIPT,
   CL_JSON_KEY_DESCRIPTION,
   CL_JSON_KEY_DETAILS,
   CL_JSON_KEY_ENDIANNESS,
@@ -44,6 +45,9 @@ typedef enum
   CL_JSON_TYPE_NUMBER,
   CL_JSON_TYPE_BOOLEAN,
 
+  /* A string left in place in the document; see cl_json_span_t */
+  CL_JSON_TYPE_SPAN,
+
   CL_JSON_TYPE_ACHIEVEMENT,
   CL_JSON_TYPE_LEADERBOARD,
   CL_JSON_TYPE_MEMORY_NOTE,
@@ -51,6 +55,19 @@ typedef enum
   CL_JSON_TYPE_SIZE
 } cl_json_type;
 
+/**
+ * A string value found within a JSON document, without being copied out or
+ * unescaped. Used for large values that are read straight from the document.
+ */
+typedef struct
+{
+  /* The first character of the string, after its opening quote */
+  const char *string;
+
+  /* The number of characters before its closing quote */
+  unsigned length;
+} cl_json_span_t;
+
 /**
  * @brief Extracts a single value from a JSON document.
  * @param data A pointer to a buffer that will be filled with the value.
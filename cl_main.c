@@ -17,14 +17,60 @@ void cle_run(void);
 #include <file/file_path.h>
 #include <string/stdstring.h>
 
+#include <stdlib.h>
 #include <time.h>
 
 cl_session_t session;
 
-static cl_error cl_init_session(const char* json)
+/**
+ * Loads the script sent by the server, from its binary encoding if the server
+ * sent one, or otherwise from text.
+ */
+static cl_error cl_init_session_script(const char *json)
 {
+  cl_json_span_t span;
   const char *iterator;
-  char script_str[2048];
+  char *script_str;
+  cl_error error;
+
+  /* Each page marks the memory notes it reads as it is loaded */
+  if (cl_memory_reset_references() != CL_OK)
+    return CL_ERR_CLIENT_RUNTIME;
+
+  /* The binary encoding is decoded in place within the response */
+  if (cl_json_get(&span, json, CL_JSON_KEY_BINARY_SCRIPT, CL_JSON_TYPE_SPAN,
+                  sizeof(span)) == CL_OK)
+  {
+    error = cl_script_init_binary(&script, span.string, span.length);
+    if (error == CL_OK)
+      return CL_OK;
+    cl_script_free(&script);
+    cl_log("Could not read binary script, falling back to text.\n");
+  }
+
+  /* Text may contain escapes, so it is copied out at its full length */
+  if (cl_json_get(&span, json, CL_JSON_KEY_SCRIPT, CL_JSON_TYPE_SPAN,
+                  sizeof(span)) != CL_OK)
+    return CL_ERR_SERVER_UNEXPECTED_RESPONSE;
+  script_str = (char*)malloc(span.length + 1);
+  if (!script_str)
+    return CL_ERR_CLIENT_RUNTIME;
+  if (cl_json_get(script_str, json, CL_JSON_KEY_SCRIPT, CL_JSON_TYPE_STRING,
+                  span.length + 1) == CL_OK)
+  {
+    iterator = script_str;
+    error = cl_script_init(&script, &iterator);
+  }
+  else
+    error = CL_ERR_SERVER_UNEXPECTED_RESPONSE;
+  free(script_str);
+
+  return error;
+}
+
+static cl_error cl_init_session(const char* json)
+{
+  cl_json_span_t span;
   unsigned misc, i;
   cl_error error;
 
@@ -74,6 +120,7 @@ static cl_error cl_init_session(const char* json)
   error = cl_abi_install_memory_regions(&memory.regions, &memory.region_count);
   if (error)
     return error;
+  cl_sort_memory_regions(memory.regions, memory.region_count);
 
   /* Get memory notes */
   cl_json_get_array((void**)&memory.notes, &memory.note_count,
@@ -81,10 +128,12 @@ static cl_error cl_init_session(const char* json)
   cl_memory_init_notes();
 
   /* Get script */
-  iterator = &script_str[0];
-  if (cl_json_get(script_str, json, CL_JSON_KEY_SCRIPT, CL_JSON_TYPE_STRING, sizeof(script_str)) == CL_OK)
+  if (cl_json_get(&span, json, CL_JSON_KEY_BINARY_SCRIPT, CL_JSON_TYPE_SPAN,
+                  sizeof(span)) == CL_OK ||
+      cl_json_get(&span, json, CL_JSON_KEY_SCRIPT, CL_JSON_TYPE_SPAN,
+                  sizeof(span)) == CL_OK)
   {
-    if (cl_script_init(&iterator) != CL_OK)
+    if (cl_init_session_script(json) != CL_OK)
     {
 #if !CL_HAVE_EDITOR
       cl_message(CL_MSG_ERROR, "Failed to initialize CL script.");
@@ -147,8 +196,8 @@ cl_error cl_start(cl_game_identifier_t identifier)
 
     post_data[0] = '\0';
     snprintf(post_data, sizeof(post_data),
-             "library=%s&filename=%s",
-             library_name, identifier.filename);
+             "library=%s&filename=%s&binary_script=%u",
+             library_name, identifier.filename, CL_SCRIPT_BINARY_VERSION);
 
     if (identifier.type == CL_GAMEIDENTIFIER_FILE_HASH)
     {
@@ -350,20 +399,29 @@ cl_error cl_run(void)
 
   if (session.state == CL_SESSION_STARTED)
   {
+    /**
+     * Rich presence notes are only read when they are about to be sent, so
+     * whether a ping is due is decided once, before memory is updated.
+     */
+    time_t now = time(0);
+    cl_bool ping_due = now >= session.last_status_update + CL_PRESENCE_INTERVAL;
+
+    if (ping_due)
+      cl_memory_include_flag(CL_MEMFLAG_RICH);
     cl_update_memory();
 
 #if CL_HAVE_EDITOR
     cle_run();
 #endif
 
-    error = cl_script_update();
+    error = cl_script_update(&script);
     if (error != CL_OK)
       return error;
 
     /* Pingback every X seconds to update rich presence */
-    if (time(0) >= session.last_status_update + CL_PRESENCE_INTERVAL)
+    if (ping_due)
     {
-      session.last_status_update = time(0);
+      session.last_status_update = now;
       cl_network_post_clint(CL_END_CLINT_PING, NULL, NULL, NULL);
     }
 
@@ -378,7 +436,7 @@ cl_error cl_free(void)
   if (session.state >= CL_SESSION_LOGGED_IN)
     cl_network_post_clint(CL_END_CLINT_CLOSE, NULL, NULL, NULL);
   cl_memory_free();
-  cl_script_free();
+  cl_script_free(&script);
   free(session.achievements);
   free(session.leaderboards);
   memset(&session, 0, sizeof(session));
@@ -3,13 +3,26 @@
 #include "cl_dma.h"
 #include "cl_memory.h"
 
+#include <float.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if CL_HAVE_FILESYSTEM
+#include <stdio.h>
+#endif
+
 #if CL_LIBRETRO
 #include <libretro.h>
 #include <stdio.h>
 #endif
 
-#if CL_HAVE_EDITOR
+#if CL_EXTERNAL_MEMORY || CL_HAVE_EDITOR
 #include "cl_abi.h"
+#endif
+
+#if CL_HAVE_EDITOR
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
@@ -17,7 +30,8 @@
 
 cl_memory_t memory;
 
-cl_memory_region_t* cl_find_memory_region(cl_addr_t address)
+cl_memory_region_t* cl_find_memory_region_hint(cl_addr_t address,
+  unsigned *hint)
 {
   if (memory.region_count == 0)
     return CL_NULL;
@@ -26,26 +40,59 @@ cl_memory_region_t* cl_find_memory_region(cl_addr_t address)
   else
   {
     cl_memory_region_t *region;
-    unsigned i;
+    unsigned low = 0;
+    unsigned high = memory.region_count;
 
-    for (i = 0; i < memory.region_count; i++)
+    if (hint && *hint < memory.region_count)
     {
-      region = &memory.regions[i];
-
+      region = &memory.regions[*hint];
       if (region->base_guest <= address &&
-        address < region->base_guest + region->size)
+          address - region->base_guest < region->size)
+        return region;
+    }
+
+    /* Regions are sorted, so find the last one starting at or before */
+    while (low < high)
+    {
+      unsigned mid = low + (high - low) / 2;
 
-      return region;
+      if (memory.regions[mid].base_guest <= address)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    if (low)
+    {
+      region = &memory.regions[low - 1];
+      if (address - region->base_guest < region->size)
+      {
+        if (hint)
+          *hint = low - 1;
+        return region;
+      }
     }
   }
 
   return CL_NULL;
 }
 
+cl_memory_region_t* cl_find_memory_region(cl_addr_t address)
+{
+  return cl_find_memory_region_hint(address, CL_NULL);
+}
+
 cl_memnote_t* cl_find_memnote(unsigned key)
 {
   unsigned i;
 
+  if (memory.note_lookup && key <= CL_MEMNOTE_KEY_MAX)
+  {
+    i = memory.note_lookup[key];
+
+    return i ? &memory.notes[i - 1] : CL_NULL;
+  }
+
+  /* Keys out of range can't be in the table, so search for them */
   for (i = 0; i < memory.note_count; i++)
   {
     if (memory.notes[i].key == key)
@@ -61,6 +108,9 @@ void cl_free_memnote(cl_memnote_t *note)
   CL_UNUSED(note);
 }
 
+#if CL_EXTERNAL_MEMORY
+static void cl_memory_batch_free(void);
+#endif
 void cl_memory_free(void)
 {
   unsigned i;
@@ -70,12 +120,220 @@ void cl_memory_free(void)
   cl_dma_free(memory.notes);
   memory.note_count = 0;
   memory.notes = CL_NULL;
+  cl_dma_free(memory.note_lookup);
+  memory.note_lookup = CL_NULL;
+  cl_dma_free(memory.chains);
+  memory.chains = CL_NULL;
+  memory.chain_count = 0;
+  cl_dma_free(memory.values_current);
+  cl_dma_free(memory.values_previous);
+  cl_dma_free(memory.values_last_unique);
+  cl_dma_free(memory.changed);
+  memory.values_current = CL_NULL;
+  memory.values_previous = CL_NULL;
+  memory.values_last_unique = CL_NULL;
+  memory.changed = CL_NULL;
+  memory.changed_count = 0;
+  cl_dma_free(memory.histories);
+  cl_dma_free(memory.history_arena);
+  memory.histories = CL_NULL;
+  memory.history_count = 0;
+  memory.history_arena = CL_NULL;
+  cl_dma_free(memory.referenced);
+  memory.referenced = CL_NULL;
+  memory.include_flags = 0;
+  memory.reference_flags = 0;
+  memory.frame = 0;
+  memory.replay = CL_NULL;
+#if CL_EXTERNAL_MEMORY
+  cl_memory_batch_free();
+#endif
 
   cl_dma_free(memory.regions);
   memory.region_count = 0;
   memory.regions = CL_NULL;
 }
 
+cl_error cl_memory_snapshot_init(cl_memory_snapshot_t *snapshot,
+  cl_memory_region_filter_t filter, const void *userdata)
+{
+  unsigned i;
+
+  if (!snapshot)
+    return CL_ERR_PARAMETER_NULL;
+
+  snapshot->data = CL_NULL;
+  snapshot->size = 0;
+  snapshot->region_count = 0;
+  snapshot->regions = (cl_memory_region_t*)cl_dma_alloc(
+    memory.region_count * sizeof(cl_memory_region_t) + 1, 0);
+  if (!snapshot->regions)
+    return CL_ERR_CLIENT_RUNTIME;
+
+  for (i = 0; i < memory.region_count; i++)
+  {
+    if (filter && !filter(&memory.regions[i], userdata))
+      continue;
+    snapshot->regions[snapshot->region_count] = memory.regions[i];
+    snapshot->size += memory.regions[i].size;
+    snapshot->region_count++;
+  }
+
+#if CL_EXTERNAL_MEMORY
+  /* Read every region once into a single pooled mapping */
+  if (cl_memory_snapshot_capture(snapshot) != CL_OK)
+  {
+    cl_memory_snapshot_free(snapshot);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+#endif
+
+  return CL_OK;
+}
+
+cl_error cl_memory_snapshot_capture(cl_memory_snapshot_t *snapshot)
+{
+  cl_addr_t offset = 0;
+  unsigned i;
+
+  if (!snapshot)
+    return CL_ERR_PARAMETER_NULL;
+
+  /* The mapping is kept between captures */
+  if (!snapshot->data && snapshot->size)
+  {
+    snapshot->data = cl_dma_map(snapshot->size);
+    if (!snapshot->data)
+      return CL_ERR_CLIENT_RUNTIME;
+  }
+  for (i = 0; i < snapshot->region_count; i++)
+  {
+    cl_memory_region_t *region = &snapshot->regions[i];
+    unsigned char *dst = (unsigned char*)snapshot->data + offset;
+#if CL_EXTERNAL_MEMORY
+    if (region->size && cl_read_memory_buffer_external(dst,
+          CL_NULL, region->base_guest, region->size) != CL_OK)
+      cl_log("Could not snapshot memory region %u.\n", i);
+#else
+    const cl_memory_region_t *live = cl_find_memory_region(region->base_guest);
+
+    if (live && live->base_host && live->base_guest == region->base_guest &&
+        live->size >= region->size)
+      memcpy(dst, live->base_host, region->size);
+    else
+      cl_log("Could not snapshot memory region %u.\n", i);
+#endif
+    region->base_host = dst;
+    offset += region->size;
+  }
+
+  return CL_OK;
+}
+
+/**
+ * Marks one changed byte in a list of changed ranges, extending the last
+ * range if the byte follows it.
+ */
+static cl_error cl_memory_range_push(cl_memory_range_t **ranges,
+  unsigned *count, unsigned *capacity, cl_addr_t address)
+{
+  if (*count && (*ranges)[*count - 1].address + (*ranges)[*count - 1].size ==
+      address)
+    (*ranges)[*count - 1].size++;
+  else
+  {
+    if (*count == *capacity)
+    {
+      unsigned new_capacity = *capacity ? *capacity * 2 : 16;
+      cl_memory_range_t *new_ranges = (cl_memory_range_t*)realloc(*ranges,
+        new_capacity * sizeof(cl_memory_range_t));
+
+      if (!new_ranges)
+        return CL_ERR_CLIENT_RUNTIME;
+      *ranges = new_ranges;
+      *capacity = new_capacity;
+    }
+    (*ranges)[*count].address = address;
+    (*ranges)[*count].size = 1;
+    (*count)++;
+  }
+
+  return CL_OK;
+}
+
+cl_error cl_memory_snapshot_diff(const cl_memory_snapshot_t *before,
+  const cl_memory_snapshot_t *after, cl_memory_range_t **ranges,
+  unsigned *range_count)
+{
+  unsigned capacity = 0;
+  unsigned i;
+
+  if (!before || !after || !ranges || !range_count)
+    return CL_ERR_PARAMETER_NULL;
+  else if (before->region_count != after->region_count)
+    return CL_ERR_PARAMETER_INVALID;
+
+  *ranges = CL_NULL;
+  *range_count = 0;
+  for (i = 0; i < before->region_count; i++)
+  {
+    const cl_memory_region_t *region = &before->regions[i];
+    const unsigned char *a = (const unsigned char*)region->base_host;
+    const unsigned char *b = (const unsigned char*)after->regions[i].base_host;
+    cl_addr_t pos = 0;
+
+    if (region->base_guest != after->regions[i].base_guest ||
+        region->size != after->regions[i].size || !a || !b)
+    {
+      cl_dma_free(*ranges);
+      *ranges = CL_NULL;
+      *range_count = 0;
+      return CL_ERR_PARAMETER_INVALID;
+    }
+
+    while (pos < region->size)
+    {
+      cl_addr_t end = pos + CL_MEMORY_DIFF_BLOCK_SIZE;
+
+      if (end > region->size)
+        end = region->size;
+
+      /* Most of memory is unchanged, so skip equal blocks in bulk */
+      if (memcmp(&a[pos], &b[pos], end - pos) == 0)
+      {
+        pos = end;
+        continue;
+      }
+      for (; pos < end; pos++)
+      {
+        if (a[pos] != b[pos] && cl_memory_range_push(ranges, range_count,
+              &capacity, region->base_guest + pos) != CL_OK)
+        {
+          cl_dma_free(*ranges);
+          *ranges = CL_NULL;
+          *range_count = 0;
+          return CL_ERR_CLIENT_RUNTIME;
+        }
+      }
+    }
+  }
+
+  return CL_OK;
+}
+
+void cl_memory_snapshot_free(cl_memory_snapshot_t *snapshot)
+{
+  if (!snapshot)
+    return;
+  if (snapshot->data)
+    cl_dma_unmap(snapshot->data, snapshot->size);
+  cl_dma_free(snapshot->regions);
+  snapshot->data = CL_NULL;
+  snapshot->size = 0;
+  snapshot->regions = CL_NULL;
+  snapshot->region_count = 0;
+}
+
 cl_error cl_get_memnote_flag(cl_memnote_t *note, cl_memnote_flag flag)
 {
   if (!note)
@@ -99,18 +357,22 @@ cl_error cl_get_memnote_value(cl_counter_t *src, cl_memnote_t *note,
 {
   if (!src || !note)
    return CL_ERR_PARAMETER_NULL;
+  else if (note < memory.notes || note >= memory.notes + memory.note_count)
+   return CL_ERR_PARAMETER_INVALID;
   else
   {
+   unsigned i = (unsigned)(note - memory.notes);
+
    switch (type)
    {
    case CL_SRCTYPE_CURRENT_RAM:
-    *src = note->current;
+    *src = memory.values_current[i];
     break;
    case CL_SRCTYPE_PREVIOUS_RAM:
-    *src = note->previous;
+    *src = memory.values_previous[i];
     break;
    case CL_SRCTYPE_LAST_UNIQUE_RAM:
-    *src = note->last_unique;
+    *src = memory.values_last_unique[i];
     break;
    default:
     return CL_ERR_PARAMETER_INVALID;
@@ -120,6 +382,33 @@ cl_error cl_get_memnote_value(cl_counter_t *src, cl_memnote_t *note,
   }
 }
 
+cl_counter_t *cl_memory_note_value(unsigned key, cl_src_t type)
+{
+  cl_memnote_t *note = cl_find_memnote(key);
+  unsigned i;
+
+  if (!note)
+    return CL_NULL;
+  i = (unsigned)(note - memory.notes);
+  switch (type)
+  {
+  case CL_SRCTYPE_CURRENT_RAM:
+    return &memory.values_current[i];
+  case CL_SRCTYPE_PREVIOUS_RAM:
+    return &memory.values_previous[i];
+  case CL_SRCTYPE_LAST_UNIQUE_RAM:
+    return &memory.values_last_unique[i];
+  default:
+    return CL_NULL;
+  }
+}
+
+cl_bool cl_memory_note_changed(unsigned index)
+{
+  return index < memory.note_count &&
+    (memory.changed[index >> 3] & (1 << (index & 7)));
+}
+
 cl_error cl_get_memnote_value_from_key(cl_counter_t *src, unsigned key,
   cl_src_t type)
 {
@@ -131,131 +420,530 @@ cl_error cl_get_memnote_value_from_key(cl_counter_t *src, unsigned key,
    return cl_get_memnote_value(src, note, type);
 }
 
-void cl_sort_memory_regions(cl_memory_region_t *banks, unsigned count)
+static int cl_memory_region_compare(const void *a, const void *b)
 {
-  unsigned i, j;
+  const cl_memory_region_t *ra = (const cl_memory_region_t*)a;
+  const cl_memory_region_t *rb = (const cl_memory_region_t*)b;
 
-  for (i = 0; i < count; ++i)
-    for (j = i + 1; j < count; ++j)
-      if (banks[i].base_guest > banks[j].base_guest)
-      {
-        cl_memory_region_t temp = banks[i];
+  if (ra->base_guest != rb->base_guest)
+    return ra->base_guest < rb->base_guest ? -1 : 1;
+  else
+    return 0;
+}
 
-        banks[i] = banks[j];
-        banks[j] = temp;
-      }
+void cl_sort_memory_regions(cl_memory_region_t *banks, unsigned count)
+{
+  if (banks && count > 1)
+    qsort(banks, count, sizeof(cl_memory_region_t), cl_memory_region_compare);
 }
 
-#if CL_LIBRETRO
-cl_error cl_init_membanks_libretro(const struct retro_memory_descriptor **descs,
-  const unsigned num_descs)
+#if !CL_EXTERNAL_MEMORY
+/**
+ * Specialized readers for each value size and endianness, so a read plan
+ * never has to switch on either while being executed.
+ */
+static void cl_memory_read_8(void *dst, const void *src)
 {
-  const struct retro_memory_descriptor *desc;
-  unsigned i, j;
+  *(unsigned char*)dst = *(const unsigned char*)src;
+}
 
-  memory.regions = (cl_memory_region_t*)calloc(num_descs,
-                                               sizeof(cl_memory_region_t));
-  memory.region_count = 0;
+static void cl_memory_read_16(void *dst, const void *src)
+{
+  memcpy(dst, src, 2);
+}
 
-  for (i = 0; i < num_descs; i++)
-  {
-    cl_memory_region_t *region = NULL;
-    desc = descs[i];
-    cl_bool ignore = CL_FALSE;
+static void cl_memory_read_16_swap(void *dst, const void *src)
+{
+  cl_read_16(dst, src, 0, CL_HOST_ENDIANNESS == _CL_ENDIANNESS_BIG ?
+    CL_ENDIAN_LITTLE : CL_ENDIAN_BIG);
+}
 
-    /* Is this region's data a null pointer? Ignore it */
-    if (!desc->ptr)
-      continue;
+static void cl_memory_read_32(void *dst, const void *src)
+{
+  memcpy(dst, src, 4);
+}
 
-    /* Is this region a mirror or subregion of another? */
-    for (j = 0; j < memory.region_count; j++)
-    {
-      if (desc->ptr == memory.regions[j].base_host)
-      {
-        cl_log("Ignoring mirror region of %s in %u\n",
-               memory.regions[j].title, i);
-        ignore = CL_TRUE;
-        break;
-      }
-      else if ((desc->ptr < memory.regions[j].base_host + memory.regions[j].size) &&
-               (desc->ptr >= memory.regions[j].base_host))
-      {
-        cl_log("Ignoring subregion of %s in %u\n",
-               memory.regions[j].title, i);
-        ignore = CL_TRUE;
-        break;
-      }
-    }
-    if (ignore)
-      continue;
+static void cl_memory_read_32_swap(void *dst, const void *src)
+{
+  cl_read_32(dst, src, 0, CL_HOST_ENDIANNESS == _CL_ENDIANNESS_BIG ?
+    CL_ENDIAN_LITTLE : CL_ENDIAN_BIG);
+}
 
-    /* Copy the libretro mmap parameters into our format */
-    region = &memory.regions[memory.region_count];
-    region->base_alloc = CL_ADDRESS_INVALID;
-    region->base_guest = desc->start;
-    region->base_host = desc->ptr;
-    region->endianness = desc->flags & RETRO_MEMDESC_BIGENDIAN ?
-      CL_ENDIAN_BIG : CL_ENDIAN_LITTLE;
-    region->flags.bits.read = 1;
-    region->flags.bits.write = desc->flags & RETRO_MEMDESC_CONST ? 0 : 1;
-    region->pointer_length = 4;
-    region->size = desc->len;
+static void cl_memory_read_64(void *dst, const void *src)
+{
+  memcpy(dst, src, 8);
+}
 
-    /* Setup the title of the memory region */
-    if (desc->addrspace)
-      snprintf(region->title, sizeof(region->title), "%s", desc->addrspace);
-    else
-      snprintf(region->title, sizeof(region->title), "Region %u/%u",
-               i + 1, num_descs);
+static void cl_memory_read_64_swap(void *dst, const void *src)
+{
+  cl_read_64(dst, src, 0, CL_HOST_ENDIANNESS == _CL_ENDIANNESS_BIG ?
+    CL_ENDIAN_LITTLE : CL_ENDIAN_BIG);
+}
 
-    memory.region_count++;
+static cl_memory_reader_t cl_memory_reader(unsigned size,
+  cl_endianness endianness)
+{
+#if CL_HOST_ENDIANNESS == _CL_ENDIANNESS_BIG
+  cl_bool swap = endianness == CL_ENDIAN_LITTLE;
+#else
+  cl_bool swap = endianness == CL_ENDIAN_BIG;
+#endif
+
+  switch (size)
+  {
+  case 1:
+    return cl_memory_read_8;
+  case 2:
+    return swap ? cl_memory_read_16_swap : cl_memory_read_16;
+  case 4:
+    return swap ? cl_memory_read_32_swap : cl_memory_read_32;
+  case 8:
+    return swap ? cl_memory_read_64_swap : cl_memory_read_64;
+  default:
+    return CL_NULL;
   }
+}
 
-  cl_sort_memory_regions(memory.regions, memory.region_count);
+#endif
 
-  for (i = 0; i < memory.region_count; i++)
+/* Caches the memory region a read plan step last fell within */
+static void cl_memnote_read_cache(cl_memnote_read_t *read,
+  const cl_memory_region_t *region)
+{
+  read->limit = 0;
+#if CL_EXTERNAL_MEMORY
+  /* External memory has no host mapping, so is always read through the ABI */
+  CL_UNUSED(region);
+#else
+  if (region->base_host && region->size >= read->size)
   {
-    cl_memory_region_t *region = &memory.regions[i];
+    read->base_guest = region->base_guest;
+    read->base_host = (const unsigned char*)region->base_host;
+    read->reader = cl_memory_reader(read->size, region->endianness);
+    if (read->reader)
+      read->limit = region->size - read->size + 1;
+  }
+#endif
+}
 
-    cl_log("Region %02X: 0x%08X | %08X bytes | %s\n", i, region->base_guest,
-           region->size, region->title);
+/**
+ * Executes one step of a read plan, reading the raw value at an address.
+ * Addresses outside of the cached region cache the region they fall within
+ * instead, or fall back to a normal memory read if it can't be cached.
+ */
+static cl_error cl_memnote_read(cl_memnote_read_t *read, void *dst,
+  cl_addr_t address, cl_value_type type)
+{
+  if (address - read->base_guest >= read->limit)
+  {
+    const cl_memory_region_t *region = cl_find_memory_region(address);
+
+    if (!region)
+      return CL_ERR_PARAMETER_INVALID;
+    /* The region found may not hold a whole value at the address */
+    cl_memnote_read_cache(read, region);
+    if (address - read->base_guest >= read->limit)
+      return cl_read_memory_value(dst, CL_NULL, address, type);
   }
+  read->reader(dst, read->base_host + (address - read->base_guest));
 
   return CL_OK;
 }
-#endif
 
-#if CL_HAVE_EDITOR
-static void cl_memnote_ex_populate_values(cl_memnote_ex_t *ex)
+static void cl_memnote_compile(cl_memnote_t *note)
 {
-  const char *desc;
-  char linebuf[512];
-  size_t i = 0;
-  unsigned count = 0;
+  const cl_memory_region_t *region;
+  unsigned passes = note->pointer_passes;
 
-  if (!ex)
+  memset(note->plan, 0, sizeof(note->plan));
+  note->chain = CL_MEMORY_CHAIN_ROOT;
+  if (passes > CL_POINTER_MAX_PASSES)
     return;
+  note->plan[passes].size = cl_sizeof_memtype(note->type);
+
+  /**
+   * Only the first read has a known address ahead of time. Pointer reads
+   * find their size from the region they fall within as they are executed.
+   */
+  region = cl_find_memory_region(note->address_initial);
+  if (region)
+  {
+    if (passes)
+      note->plan[0].size = region->pointer_length;
+    cl_memnote_read_cache(&note->plan[0], region);
+  }
+}
 
-  memset(ex->values, 0, sizeof(ex->values));
-  ex->value_count = 0;
-
-  desc = ex->description;
-  if (!desc || desc[0] == '\0')
-    return;
+/**
+ * Executes a pointer read of a read plan. The size of a pointer depends on the
+ * region it is in, so this is checked before the read itself.
+ */
+static cl_error cl_memnote_read_pointer(cl_memnote_read_t *read,
+  cl_addr_t address, cl_addr_t *pointer)
+{
+  cl_uint64 pointer_64 = 0;
+  uint32_t pointer_32 = 0;
+  uint16_t pointer_16 = 0;
 
-  while (*desc && count < 64)
+  if (address - read->base_guest >= read->limit)
   {
-    /* Extract one line */
-    i = 0;
-    while (*desc && *desc != '\n' && i < sizeof(linebuf) - 1)
-      linebuf[i++] = *desc++;
-    linebuf[i] = '\0';
-
-    /* Skip newline */
-    if (*desc == '\n')
-      desc++;
+    const cl_memory_region_t *region = cl_find_memory_region(address);
 
-    /* Trim leading spaces */
+    if (!region)
+      return CL_ERR_PARAMETER_NULL;
+    read->size = region->pointer_length;
+    cl_memnote_read_cache(read, region);
+  }
+
+  switch (read->size)
+  {
+  case 2:
+    if (cl_memnote_read(read, &pointer_16, address,
+                        CL_MEMTYPE_UINT16) != CL_OK)
+      return CL_ERR_CLIENT_RUNTIME;
+    *pointer = pointer_16;
+    break;
+  case 4:
+    if (cl_memnote_read(read, &pointer_32, address,
+                        CL_MEMTYPE_UINT32) != CL_OK)
+      return CL_ERR_CLIENT_RUNTIME;
+    *pointer = pointer_32;
+    break;
+  case 8:
+    if (cl_memnote_read(read, &pointer_64, address,
+                        CL_MEMTYPE_INT64) != CL_OK)
+      return CL_ERR_CLIENT_RUNTIME;
+    *pointer = (cl_addr_t)pointer_64;
+    break;
+  default:
+    return CL_ERR_PARAMETER_INVALID;
+  }
+
+  return CL_OK;
+}
+
+/**
+ * Returns the value identifying one level of a memory note's pointer chain:
+ * the initial address for the first level, then each offset.
+ */
+static cl_addr_t cl_memnote_chain_key(const cl_memnote_t *note, unsigned depth)
+{
+  return depth ? note->pointer_offsets[depth - 1] : note->address_initial;
+}
+
+static int cl_memnote_chain_compare(const void *a, const void *b)
+{
+  const cl_memnote_t *na = &memory.notes[*(const unsigned*)a];
+  const cl_memnote_t *nb = &memory.notes[*(const unsigned*)b];
+  unsigned i;
+
+  for (i = 0; i < na->pointer_passes && i < nb->pointer_passes; i++)
+  {
+    cl_addr_t ka = cl_memnote_chain_key(na, i);
+    cl_addr_t kb = cl_memnote_chain_key(nb, i);
+
+    if (ka != kb)
+      return ka < kb ? -1 : 1;
+  }
+  if (na->pointer_passes != nb->pointer_passes)
+    return na->pointer_passes < nb->pointer_passes ? -1 : 1;
+  else
+    return 0;
+}
+
+/**
+ * Merges the pointer chains of every memory note into a tree. Sorting the
+ * chains puts those sharing leading levels next to each other, so each one
+ * only needs comparing to the one before it.
+ */
+static void cl_memory_compile_chains(void)
+{
+  unsigned path[CL_POINTER_MAX_PASSES];
+  const cl_memnote_t *prev = CL_NULL;
+  unsigned *order;
+  unsigned count = 0;
+  unsigned capacity = 0;
+  unsigned i, j;
+
+  cl_dma_free(memory.chains);
+  memory.chains = CL_NULL;
+  memory.chain_count = 0;
+
+  for (i = 0; i < memory.note_count; i++)
+  {
+    if (!memory.notes[i].pointer_passes ||
+        memory.notes[i].pointer_passes > CL_POINTER_MAX_PASSES)
+      continue;
+    count++;
+    capacity += memory.notes[i].pointer_passes;
+  }
+  if (!count)
+    return;
+
+  /* Without the tree, notes resolve their own pointers */
+  order = (unsigned*)cl_dma_alloc(count * sizeof(unsigned), 0);
+  memory.chains = (cl_memory_chain_t*)cl_dma_alloc(
+    capacity * sizeof(cl_memory_chain_t), 1);
+  if (!order || !memory.chains)
+  {
+    cl_dma_free(order);
+    cl_dma_free(memory.chains);
+    memory.chains = CL_NULL;
+    return;
+  }
+  for (i = 0, j = 0; i < memory.note_count; i++)
+    if (memory.notes[i].pointer_passes &&
+        memory.notes[i].pointer_passes <= CL_POINTER_MAX_PASSES)
+      order[j++] = i;
+  qsort(order, count, sizeof(unsigned), cl_memnote_chain_compare);
+
+  for (i = 0; i < count; i++)
+  {
+    cl_memnote_t *note = &memory.notes[order[i]];
+
+    /* Reuse the levels this chain has in common with the last one */
+    j = 0;
+    if (prev)
+      while (j < note->pointer_passes && j < prev->pointer_passes &&
+             cl_memnote_chain_key(note, j) == cl_memnote_chain_key(prev, j))
+        j++;
+    for (; j < note->pointer_passes; j++)
+    {
+      cl_memory_chain_t *node = &memory.chains[memory.chain_count];
+
+      node->parent = j ? path[j - 1] : CL_MEMORY_CHAIN_ROOT;
+      node->depth = j;
+      node->offset = cl_memnote_chain_key(note, j);
+      path[j] = memory.chain_count++;
+    }
+    note->chain = path[note->pointer_passes - 1];
+    prev = note;
+  }
+  cl_dma_free(order);
+
+  cl_log("Memory notes read %u pointers over %u pointer chains.\n",
+    memory.chain_count, count);
+}
+
+void cl_memory_compile_notes(void)
+{
+  unsigned i;
+
+  for (i = 0; i < memory.note_count; i++)
+    cl_memnote_compile(&memory.notes[i]);
+  cl_memory_compile_chains();
+}
+
+/* Returns whether a memory note should be read on this update */
+static cl_bool cl_memory_note_wanted(unsigned index)
+{
+#if CL_HAVE_EDITOR
+  /* The editor shows the value of every note */
+  CL_UNUSED(index);
+  return CL_TRUE;
+#else
+  return !memory.referenced ||
+    (memory.referenced[index >> 3] & (1 << (index & 7))) ||
+    (memory.notes[index].flags &
+      (memory.include_flags | memory.reference_flags));
+#endif
+}
+
+/* Marks the chain nodes read through by the notes wanted on this update */
+static void cl_memory_mark_chains(void)
+{
+  unsigned i;
+
+  for (i = 0; i < memory.chain_count; i++)
+    memory.chains[i].needed = CL_FALSE;
+  for (i = 0; i < memory.note_count; i++)
+  {
+    unsigned node = memory.notes[i].chain;
+
+    if (!cl_memory_note_wanted(i))
+      continue;
+    while (node != CL_MEMORY_CHAIN_ROOT && !memory.chains[node].needed)
+    {
+      memory.chains[node].needed = CL_TRUE;
+      node = memory.chains[node].parent;
+    }
+  }
+}
+
+cl_error cl_memory_reset_references(void)
+{
+  cl_dma_free(memory.referenced);
+  memory.referenced = (unsigned char*)cl_dma_alloc(
+    (memory.note_count + 7) / 8 + 1, CL_TRUE);
+  memory.reference_flags = 0;
+
+  return memory.referenced ? CL_OK : CL_ERR_CLIENT_RUNTIME;
+}
+
+cl_error cl_memory_reference_note(unsigned key)
+{
+  const cl_memnote_t *note = cl_find_memnote(key);
+  unsigned index;
+
+  if (!note)
+    return CL_ERR_PARAMETER_INVALID;
+  else if (!memory.referenced)
+    return CL_OK;
+  index = (unsigned)(note - memory.notes);
+  memory.referenced[index >> 3] |= (unsigned char)(1 << (index & 7));
+
+  return CL_OK;
+}
+
+void cl_memory_include_flag(cl_memnote_flag flag)
+{
+  memory.include_flags |= 1 << flag;
+}
+
+void cl_memory_reference_flag(cl_memnote_flag flag)
+{
+  memory.reference_flags |= 1 << flag;
+}
+
+#if !CL_EXTERNAL_MEMORY
+/* Reads every needed pointer in the chain tree once, parents first */
+static void cl_memory_update_chains(void)
+{
+  unsigned i;
+
+  for (i = 0; i < memory.chain_count; i++)
+  {
+    cl_memory_chain_t *node = &memory.chains[i];
+    cl_addr_t address;
+
+    if (!node->needed)
+      continue;
+    else if (node->parent == CL_MEMORY_CHAIN_ROOT)
+      address = node->offset;
+    else if (memory.chains[node->parent].valid)
+      address = memory.chains[node->parent].pointer + node->offset;
+    else
+    {
+      node->valid = CL_FALSE;
+      continue;
+    }
+    node->valid = cl_memnote_read_pointer(&node->read, address,
+      &node->pointer) == CL_OK;
+  }
+}
+#endif
+
+#if CL_LIBRETRO
+cl_error cl_init_membanks_libretro(const struct retro_memory_descriptor **descs,
+  const unsigned num_descs)
+{
+  const struct retro_memory_descriptor *desc;
+  unsigned i, j;
+
+  memory.regions = (cl_memory_region_t*)calloc(num_descs,
+                                               sizeof(cl_memory_region_t));
+  memory.region_count = 0;
+
+  for (i = 0; i < num_descs; i++)
+  {
+    cl_memory_region_t *region = NULL;
+    desc = descs[i];
+    cl_bool ignore = CL_FALSE;
+
+    /* Is this region's data a null pointer? Ignore it */
+    if (!desc->ptr)
+      continue;
+
+    /* Is this region a mirror or subregion of another? */
+    for (j = 0; j < memory.region_count; j++)
+    {
+      if (desc->ptr == memory.regions[j].base_host)
+      {
+        cl_log("Ignoring mirror region of %s in %u\n",
+               memory.regions[j].title, i);
+        ignore = CL_TRUE;
+        break;
+      }
+      else if ((desc->ptr < memory.regions[j].base_host + memory.regions[j].size) &&
+               (desc->ptr >= memory.regions[j].base_host))
+      {
+        cl_log("Ignoring subregion of %s in %u\n",
+               memory.regions[j].title, i);
+        ignore = CL_TRUE;
+        break;
+      }
+    }
+    if (ignore)
+      continue;
+
+    /* Copy the libretro mmap parameters into our format */
+    region = &memory.regions[memory.region_count];
+    region->base_alloc = CL_ADDRESS_INVALID;
+    region->base_guest = desc->start;
+    region->base_host = desc->ptr;
+    region->endianness = desc->flags & RETRO_MEMDESC_BIGENDIAN ?
+      CL_ENDIAN_BIG : CL_ENDIAN_LITTLE;
+    region->flags.bits.read = 1;
+    region->flags.bits.write = desc->flags & RETRO_MEMDESC_CONST ? 0 : 1;
+    region->pointer_length = 4;
+    region->size = desc->len;
+
+    /* Setup the title of the memory region */
+    if (desc->addrspace)
+      snprintf(region->title, sizeof(region->title), "%s", desc->addrspace);
+    else
+      snprintf(region->title, sizeof(region->title), "Region %u/%u",
+               i + 1, num_descs);
+
+    memory.region_count++;
+  }
+
+  cl_sort_memory_regions(memory.regions, memory.region_count);
+  cl_memory_compile_notes();
+
+  for (i = 0; i < memory.region_count; i++)
+  {
+    cl_memory_region_t *region = &memory.regions[i];
+
+    cl_log("Region %02X: 0x%08X | %08X bytes | %s\n", i, region->base_guest,
+           region->size, region->title);
+  }
+
+  return CL_OK;
+}
+#endif
+
+#if CL_HAVE_EDITOR
+static void cl_memnote_ex_populate_values(cl_memnote_ex_t *ex)
+{
+  const char *desc;
+  char linebuf[512];
+  size_t i = 0;
+  unsigned count = 0;
+
+  if (!ex)
+    return;
+
+  memset(ex->values, 0, sizeof(ex->values));
+  ex->value_count = 0;
+
+  desc = ex->description;
+  if (!desc || desc[0] == '\0')
+    return;
+
+  while (*desc && count < 64)
+  {
+    /* Extract one line */
+    i = 0;
+    while (*desc && *desc != '\n' && i < sizeof(linebuf) - 1)
+      linebuf[i++] = *desc++;
+    linebuf[i] = '\0';
+
+    /* Skip newline */
+    if (*desc == '\n')
+      desc++;
+
+    /* Trim leading spaces */
     char *p = linebuf;
     while (isspace((unsigned char)*p))
       p++;
@@ -305,8 +993,6 @@ static void cl_memnote_ex_populate_values(cl_memnote_ex_t *ex)
 
 static cl_error cl_memory_init_note(cl_memnote_t *note)
 {
-  cl_counter_t counter;
-
   cl_log("Memory note {%04u} - S: %u, P: %u, A: %08X",
          note->key,
          cl_sizeof_memtype(note->type),
@@ -331,17 +1017,89 @@ static cl_error cl_memory_init_note(cl_memnote_t *note)
 
   cl_log("\n");
 
-  /* Initialize the counters based on the data type of the note */
-  counter.floatval.fp = 0;
-  counter.intval.i64 = 0;
-  counter.type = note->type;
-  note->current = counter;
-  note->previous = counter;
-  note->last_unique = counter;
+  return CL_OK;
+}
+
+/**
+ * Resizes the value arrays to fit every memory note, and initializes the
+ * values of the notes from `first` onward based on their data type.
+ */
+static cl_error cl_memory_init_values(unsigned first)
+{
+  unsigned count = memory.note_count;
+  void *p;
+  unsigned i;
+
+  if ((p = realloc(memory.values_current, count * sizeof(cl_counter_t))) != NULL)
+    memory.values_current = (cl_counter_t*)p;
+  else
+    return CL_ERR_CLIENT_RUNTIME;
+  if ((p = realloc(memory.values_previous, count * sizeof(cl_counter_t))) != NULL)
+    memory.values_previous = (cl_counter_t*)p;
+  else
+    return CL_ERR_CLIENT_RUNTIME;
+  if ((p = realloc(memory.values_last_unique, count * sizeof(cl_counter_t))) != NULL)
+    memory.values_last_unique = (cl_counter_t*)p;
+  else
+    return CL_ERR_CLIENT_RUNTIME;
+  if ((p = realloc(memory.changed, (count + 7) / 8)) != NULL)
+    memory.changed = (unsigned char*)p;
+  else
+    return CL_ERR_CLIENT_RUNTIME;
+  memset(memory.changed, 0, (count + 7) / 8);
+  memory.changed_count = 0;
+
+  /* New notes start out unreferenced */
+  if (memory.referenced)
+  {
+    if ((p = realloc(memory.referenced, (count + 7) / 8)) != NULL)
+      memory.referenced = (unsigned char*)p;
+    else
+      return CL_ERR_CLIENT_RUNTIME;
+    memset(&memory.referenced[(first + 7) / 8], 0,
+      (count + 7) / 8 - (first + 7) / 8);
+  }
+
+  for (i = first; i < count; i++)
+  {
+    cl_counter_t counter;
+
+    counter.floatval.fp = 0;
+    counter.intval.i64 = 0;
+    counter.type = memory.notes[i].type;
+    memory.values_current[i] = counter;
+    memory.values_previous[i] = counter;
+    memory.values_last_unique[i] = counter;
+  }
 
   return CL_OK;
 }
 
+/**
+ * Adds a memory note to the key lookup table. If another note already has the
+ * same key, the earlier one is kept, matching a search through the list.
+ */
+static void cl_memory_index_note(unsigned index)
+{
+  unsigned key = memory.notes[index].key;
+
+  if (memory.note_lookup && key <= CL_MEMNOTE_KEY_MAX &&
+      !memory.note_lookup[key])
+    memory.note_lookup[key] = index + 1;
+}
+
+/* Rebuilds the key lookup table from the whole list of memory notes */
+static void cl_memory_index_notes(void)
+{
+  unsigned i;
+
+  cl_dma_free(memory.note_lookup);
+  memory.note_lookup = (unsigned*)cl_dma_alloc(
+    (CL_MEMNOTE_KEY_MAX + 1) * sizeof(unsigned), 1);
+  for (i = 0; i < memory.note_count; i++)
+    cl_memory_index_note(i);
+}
+
 cl_error cl_memory_init_notes(void)
 {
   unsigned i;
@@ -353,6 +1111,12 @@ cl_error cl_memory_init_notes(void)
 
   for (i = 0; i < memory.note_count; i++)
     cl_memory_init_note(&memory.notes[i]);
+  if (cl_memory_init_values(0) != CL_OK)
+    return CL_ERR_CLIENT_RUNTIME;
+  cl_memory_compile_notes();
+
+  /* Without the table, notes are still found by searching the list */
+  cl_memory_index_notes();
   cl_log("End of memory.\n");
 
   return CL_OK;
@@ -376,9 +1140,19 @@ cl_error cl_memory_add_note(const cl_memnote_t *note)
   cl_memnote_ex_populate_values(&memory.notes[memory.note_count].details);
 #endif
   memory.note_count++;
-
-  cl_log("Added memnote {%04u} - S: %u, P: %u, A: %08X\n",
-    note->key,
+  if (cl_memory_init_values(memory.note_count - 1) != CL_OK)
+  {
+    memory.note_count--;
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_memory_compile_notes();
+  if (memory.note_lookup)
+    cl_memory_index_note(memory.note_count - 1);
+  else
+    cl_memory_index_notes();
+
+  cl_log("Added memnote {%04u} - S: %u, P: %u, A: %08X\n",
+    note->key,
     cl_sizeof_memtype(note->type),
     note->pointer_passes,
     note->address_initial);
@@ -495,9 +1269,8 @@ cl_error cl_write_memory_value_external(const void *value,
 #endif
 
 /**
- * Gets the final address referenced by a memory note's chain of pointers, and
- * reads it into a buffer.
- * @param address The buffer to read the address into.
+ * Gets the final address referenced by a memory note's chain of pointers,
+ * following its read plan.
  * @param note A pointer to the memory note to have its address resolved.
  * @return CL_OK if the final address could be inferred from the note; error code otherwise.
  **/
@@ -508,104 +1281,1063 @@ static cl_error cl_memnote_resolve_ptrs(cl_memnote_t *note)
 
   for (i = 0; i < note->pointer_passes; i++)
   {
-    const cl_memory_region_t *region = cl_find_memory_region(final_addr);
+    cl_error error = cl_memnote_read_pointer(&note->plan[i], final_addr,
+      &final_addr);
 
-    if (!region)
-      return CL_ERR_PARAMETER_NULL;
+    if (error != CL_OK)
+      return error;
+    final_addr += note->pointer_offsets[i];
+  }
+  note->address = final_addr;
+
+  return CL_OK;
+}
+
+/**
+ * Marks a memory note in the change bitset if the value just stored for it
+ * differs from the previous frame.
+ */
+static void cl_memnote_stored(unsigned i)
+{
+  /* Logic for "last unique" values; the previous value will persist */
+  if (!cl_ctr_equal_exact(&memory.values_previous[i],
+                          &memory.values_current[i]))
+  {
+    memory.values_last_unique[i] = memory.values_previous[i];
+    memory.changed[i >> 3] |= (unsigned char)(1 << (i & 7));
+    memory.changed_count++;
+  }
+}
+
+/**
+ * Moves a memory note on to a new frame with a newly read value, and marks it
+ * in the change bitset if the value differs from the previous frame.
+ */
+static void cl_memnote_store(cl_memnote_t *note, const void *value)
+{
+  unsigned i = (unsigned)(note - memory.notes);
+  cl_counter_t *current = &memory.values_current[i];
+  cl_counter_t *previous = &memory.values_previous[i];
+
+  /* The "previous" value is the value from the previous frame */
+  *previous = *current;
+
+  cl_ctr_store(current, value, note->type);
+  cl_memnote_stored(i);
+}
+
+static cl_error cl_update_memnote(cl_memnote_t *note)
+{
+  cl_error error;
+  cl_int64 new_val;
+
+  if (!note)
+    return CL_ERR_PARAMETER_NULL;
+
+  /* Use the pointer already read through the chain tree this frame */
+  if (note->chain != CL_MEMORY_CHAIN_ROOT)
+  {
+    const cl_memory_chain_t *node = &memory.chains[note->chain];
+
+    if (!node->valid)
+      return CL_ERR_CLIENT_RUNTIME;
+    note->address = node->pointer +
+      note->pointer_offsets[note->pointer_passes - 1];
+  }
+  else
+  {
+    error = cl_memnote_resolve_ptrs(note);
+    if (error != CL_OK)
+      return error;
+  }
+  note->resolved_frame = memory.frame;
+
+  new_val = 0;
+  cl_memnote_read(&note->plan[note->pointer_passes], &new_val, note->address,
+    note->type);
+  cl_memnote_store(note, &new_val);
+
+  return CL_OK;
+}
+
+#if CL_EXTERNAL_MEMORY
+
+/* One value to be read from external memory as part of a batch */
+typedef struct
+{
+  cl_addr_t address;
+  unsigned size;
+
+  /* The memory note or chain node this value is read for */
+  unsigned index;
+  cl_bool is_note;
+
+  /* The region the value is in, for its endianness */
+  const cl_memory_region_t *region;
+
+  /* The span the value is read with, and its position in the buffer */
+  unsigned span;
+  cl_addr_t offset;
+} cl_memory_batch_read_t;
+
+/* Scratch space for batched reads, kept between frames */
+static cl_memory_batch_read_t *cl_batch_reads = CL_NULL;
+static unsigned cl_batch_count = 0;
+static unsigned cl_batch_capacity = 0;
+static cl_memory_span_t *cl_batch_spans = CL_NULL;
+static unsigned char *cl_batch_buffer = CL_NULL;
+static cl_addr_t cl_batch_buffer_size = 0;
+
+static void cl_memory_batch_free(void)
+{
+  free(cl_batch_reads);
+  free(cl_batch_spans);
+  free(cl_batch_buffer);
+  cl_batch_reads = CL_NULL;
+  cl_batch_spans = CL_NULL;
+  cl_batch_buffer = CL_NULL;
+  cl_batch_count = 0;
+  cl_batch_capacity = 0;
+  cl_batch_buffer_size = 0;
+}
+
+/**
+ * Queues a value to be read in the next batch. Values outside of any region
+ * are not queued, as their endianness is unknown, and neither are values
+ * that run past the end of their region, as no span can read them in full.
+ * Those are read on their own instead.
+ */
+static cl_bool cl_memory_batch_push(cl_addr_t address, unsigned size,
+  unsigned index, cl_bool is_note, unsigned *hint)
+{
+  const cl_memory_region_t *region = cl_find_memory_region_hint(address, hint);
+  cl_memory_batch_read_t *read;
+
+  if (!region || !size || address < region->base_guest ||
+      address - region->base_guest >= region->size ||
+      size > region->size - (address - region->base_guest))
+    return CL_FALSE;
+  else if (cl_batch_count == cl_batch_capacity)
+  {
+    unsigned capacity = cl_batch_capacity ? cl_batch_capacity * 2 : 64;
+    void *reads = realloc(cl_batch_reads,
+      capacity * sizeof(cl_memory_batch_read_t));
+    void *spans = realloc(cl_batch_spans, capacity * sizeof(cl_memory_span_t));
+
+    if (reads)
+      cl_batch_reads = (cl_memory_batch_read_t*)reads;
+    if (spans)
+      cl_batch_spans = (cl_memory_span_t*)spans;
+    if (!reads || !spans)
+      return CL_FALSE;
+    cl_batch_capacity = capacity;
+  }
+  read = &cl_batch_reads[cl_batch_count++];
+  read->address = address;
+  read->size = size;
+  read->index = index;
+  read->is_note = is_note;
+  read->region = region;
+
+  return CL_TRUE;
+}
+
+static int cl_memory_batch_compare(const void *a, const void *b)
+{
+  const cl_memory_batch_read_t *ra = (const cl_memory_batch_read_t*)a;
+  const cl_memory_batch_read_t *rb = (const cl_memory_batch_read_t*)b;
+
+  if (ra->address != rb->address)
+    return ra->address < rb->address ? -1 : 1;
+  else
+    return 0;
+}
+
+/**
+ * Reads every queued value. Values close together are merged into spans so
+ * they are read at once, then all spans are given to the frontend together.
+ * @return Whether the values were read; if not, none of them are valid.
+ */
+static cl_bool cl_memory_batch_read(void)
+{
+  cl_addr_t total = 0;
+  cl_addr_t end = 0;
+  unsigned span_count = 0;
+  unsigned i;
+
+  if (!cl_batch_count)
+    return CL_TRUE;
+  qsort(cl_batch_reads, cl_batch_count, sizeof(cl_memory_batch_read_t),
+    cl_memory_batch_compare);
+
+  for (i = 0; i < cl_batch_count; i++)
+  {
+    cl_memory_batch_read_t *read = &cl_batch_reads[i];
+    cl_memory_span_t *span;
+
+    /**
+     * Spans never cross into another region. The gap between two regions may
+     * be unmapped, and a scattered read stops at the first fault.
+     */
+    if (!span_count || read->address > end + CL_EXTERNAL_READ_GAP ||
+        read->region != cl_batch_reads[i - 1].region)
+    {
+      span = &cl_batch_spans[span_count++];
+      span->address = read->address;
+      span->size = 0;
+      end = read->address;
+    }
     else
+      span = &cl_batch_spans[span_count - 1];
+    if (read->address + read->size > end)
+    {
+      total += read->address + read->size - end;
+      end = read->address + read->size;
+      span->size = (unsigned)(end - span->address);
+    }
+    read->span = span_count - 1;
+    read->offset = total - (end - read->address);
+  }
+
+  if (total > cl_batch_buffer_size)
+  {
+    void *buffer = realloc(cl_batch_buffer, total);
+
+    if (!buffer)
+      return CL_FALSE;
+    cl_batch_buffer = (unsigned char*)buffer;
+    cl_batch_buffer_size = total;
+  }
+  for (i = 0, total = 0; i < span_count; i++)
+  {
+    cl_batch_spans[i].dest = cl_batch_buffer + total;
+    cl_batch_spans[i].read = 0;
+    total += cl_batch_spans[i].size;
+  }
+
+  return cl_abi_external_read_scatter(cl_batch_spans, span_count) == CL_OK;
+}
+
+/* Whether a value in the last batch was read in full */
+static cl_bool cl_memory_batch_valid(const cl_memory_batch_read_t *read)
+{
+  const cl_memory_span_t *span = &cl_batch_spans[read->span];
+
+  return read->address - span->address + read->size <= span->read;
+}
+
+/**
+ * Updates every memory note with as few reads of external memory as
+ * possible. Each level of the chain tree needs the pointers of the level
+ * before it, so one batch is read per level, along with the values of the
+ * notes whose chains end there.
+ */
+static void cl_memory_update_batched(void)
+{
+  unsigned hint = 0;
+  unsigned depth, i;
+
+  for (depth = 0; depth <= CL_POINTER_MAX_PASSES; depth++)
+  {
+    cl_bool ok;
+
+    cl_batch_count = 0;
+    for (i = 0; i < memory.chain_count; i++)
+    {
+      cl_memory_chain_t *node = &memory.chains[i];
+      const cl_memory_region_t *region;
+      cl_addr_t address;
+
+      if (node->depth != depth || !node->needed)
+        continue;
+      node->valid = CL_FALSE;
+      if (node->parent == CL_MEMORY_CHAIN_ROOT)
+        address = node->offset;
+      else if (memory.chains[node->parent].valid)
+        address = memory.chains[node->parent].pointer + node->offset;
+      else
+        continue;
+      region = cl_find_memory_region_hint(address, &hint);
+      if (region)
+        cl_memory_batch_push(address, region->pointer_length, i, CL_FALSE,
+          &hint);
+    }
+    for (i = 0; i < memory.note_count; i++)
     {
-      cl_value_type ptr_type;
+      cl_memnote_t *note = &memory.notes[i];
 
-      switch (region->pointer_length)
+      if (!cl_memory_note_wanted(i))
+        continue;
+      /* Notes outside of the chain tree are read on their own */
+      else if (note->pointer_passes && note->chain == CL_MEMORY_CHAIN_ROOT)
       {
-      case 2:
-        ptr_type = CL_MEMTYPE_UINT16;
-        break;
-      case 4:
-        ptr_type = CL_MEMTYPE_UINT32;
-        break;
-      case 8:
-        ptr_type = CL_MEMTYPE_INT64;
-        break;
-      default:
-        return CL_ERR_PARAMETER_INVALID;
+        if (depth == 0)
+          cl_update_memnote(note);
+        continue;
       }
-      if (cl_read_memory_value(&final_addr, CL_NULL, final_addr,
-                               ptr_type) != CL_OK)
-        return CL_ERR_CLIENT_RUNTIME;
+      else if (note->pointer_passes != depth)
+        continue;
+      else if (depth)
+      {
+        const cl_memory_chain_t *node = &memory.chains[note->chain];
 
-      final_addr += note->pointer_offsets[i];
+        if (!node->valid)
+          continue;
+        note->address = node->pointer + note->pointer_offsets[depth - 1];
+      }
+      else
+        note->address = note->address_initial;
+      note->resolved_frame = memory.frame;
+      if (!cl_memory_batch_push(note->address, cl_sizeof_memtype(note->type),
+            i, CL_TRUE, &hint))
+        cl_update_memnote(note);
+    }
+    ok = cl_memory_batch_read();
+
+    for (i = 0; i < cl_batch_count; i++)
+    {
+      const cl_memory_batch_read_t *read = &cl_batch_reads[i];
+      cl_bool valid = ok && cl_memory_batch_valid(read);
+
+      if (read->is_note)
+      {
+        cl_int64 new_val = 0;
+
+        /* Unreadable values are stored as zero, as with a single read */
+        if (valid)
+          cl_read_value(&new_val, cl_batch_buffer, read->offset,
+            memory.notes[read->index].type, read->region->endianness);
+        cl_memnote_store(&memory.notes[read->index], &new_val);
+      }
+      else if (valid)
+      {
+        cl_memory_chain_t *node = &memory.chains[read->index];
+        cl_uint64 pointer_64 = 0;
+        uint32_t pointer_32 = 0;
+        uint16_t pointer_16 = 0;
+
+        node->valid = CL_TRUE;
+        switch (read->size)
+        {
+        case 2:
+          cl_read_16(&pointer_16, cl_batch_buffer, read->offset,
+            read->region->endianness);
+          node->pointer = pointer_16;
+          break;
+        case 4:
+          cl_read_32(&pointer_32, cl_batch_buffer, read->offset,
+            read->region->endianness);
+          node->pointer = pointer_32;
+          break;
+        case 8:
+          cl_read_64(&pointer_64, cl_batch_buffer, read->offset,
+            read->region->endianness);
+          node->pointer = (cl_addr_t)pointer_64;
+          break;
+        default:
+          node->valid = CL_FALSE;
+        }
+      }
     }
   }
-  note->address = final_addr;
+}
+
+#endif
+
+/**
+ * Lays out the ring buffers of every history in one new arena, and resets
+ * them all to empty.
+ */
+static cl_error cl_memory_history_layout(void)
+{
+  cl_counter_t *values;
+  unsigned *indices;
+  unsigned total = 0;
+  unsigned i;
+
+  for (i = 0; i < memory.history_count; i++)
+    total += memory.histories[i].length;
+  cl_dma_free(memory.history_arena);
+  memory.history_arena = cl_dma_alloc(
+    total * (sizeof(cl_counter_t) + 2 * sizeof(unsigned)), CL_FALSE);
+  if (!memory.history_arena)
+    return CL_ERR_CLIENT_RUNTIME;
+
+  /* All values first, so the indices after them stay aligned */
+  values = (cl_counter_t*)memory.history_arena;
+  indices = (unsigned*)(values + total);
+  for (i = 0; i < memory.history_count; i++)
+  {
+    cl_memory_history_t *history = &memory.histories[i];
+
+    history->values = values;
+    history->min_deque = indices;
+    history->max_deque = indices + history->length;
+    values += history->length;
+    indices += 2 * history->length;
+
+    history->count = 0;
+    history->frame = 0;
+    history->min_head = 0;
+    history->min_count = 0;
+    history->max_head = 0;
+    history->max_count = 0;
+    history->held = 0;
+    cl_ctr_store_int(&history->sum, 0);
+  }
 
   return CL_OK;
 }
 
-static cl_error cl_update_memnote(cl_memnote_t *note)
+cl_error cl_memory_history_request(unsigned key, unsigned frames)
 {
-  cl_error error;
-  cl_int64 new_val;
+  const cl_memnote_t *note = cl_find_memnote(key);
+  cl_memory_history_t *histories;
+  unsigned index;
 
   if (!note)
+    return CL_ERR_PARAMETER_INVALID;
+  else if (frames == 0 || frames > CL_MEMORY_HISTORY_MAX)
+    return CL_ERR_PARAMETER_INVALID;
+  else if (cl_memory_history_find(key, frames))
+    return CL_OK;
+
+  index = (unsigned)(note - memory.notes);
+  histories = (cl_memory_history_t*)realloc(memory.histories,
+    (memory.history_count + 1) * sizeof(cl_memory_history_t));
+  if (!histories)
+    return CL_ERR_CLIENT_RUNTIME;
+  memory.histories = histories;
+  memory.histories[memory.history_count].note = index;
+  memory.histories[memory.history_count].length = frames;
+  memory.history_count++;
+
+  return cl_memory_history_layout();
+}
+
+cl_memory_history_t *cl_memory_history_find(unsigned key, unsigned frames)
+{
+  const cl_memnote_t *note = cl_find_memnote(key);
+  unsigned i;
+
+  if (!note)
+    return CL_NULL;
+  for (i = 0; i < memory.history_count; i++)
+    if (memory.histories[i].note == (unsigned)(note - memory.notes) &&
+        memory.histories[i].length == frames)
+      return &memory.histories[i];
+
+  return CL_NULL;
+}
+
+cl_memory_history_t *cl_memory_history_at(unsigned index)
+{
+  return index < memory.history_count ? &memory.histories[index] : CL_NULL;
+}
+
+/* Records the current value of a memory note as the newest in its window */
+static void cl_memory_history_push(cl_memory_history_t *history)
+{
+  const cl_counter_t *value = &memory.values_current[history->note];
+  unsigned frame = history->frame;
+  unsigned length = history->length;
+  unsigned slot = frame % length;
+
+  /* Drop the frame leaving the window from the front of each deque */
+  if (history->min_count &&
+      frame - history->min_deque[history->min_head] >= length)
+  {
+    history->min_head = (history->min_head + 1) % length;
+    history->min_count--;
+  }
+  if (history->max_count &&
+      frame - history->max_deque[history->max_head] >= length)
+  {
+    history->max_head = (history->max_head + 1) % length;
+    history->max_count--;
+  }
+
+  /* Replace the oldest value in the ring */
+  if (history->count == length)
+    cl_ctr_subtract(&history->sum, &history->values[slot]);
+  else
+    history->count++;
+  history->values[slot] = *value;
+  cl_ctr_add(&history->sum, value);
+
+  /* Drop candidates the new value beats, then add it to the back */
+  while (history->min_count && !cl_ctr_lesser(&history->values[
+    history->min_deque[(history->min_head + history->min_count - 1) % length] %
+    length], value))
+    history->min_count--;
+  history->min_deque[(history->min_head + history->min_count) % length] = frame;
+  history->min_count++;
+  while (history->max_count && !cl_ctr_greater(&history->values[
+    history->max_deque[(history->max_head + history->max_count - 1) % length] %
+    length], value))
+    history->max_count--;
+  history->max_deque[(history->max_head + history->max_count) % length] = frame;
+  history->max_count++;
+
+  if (cl_memory_note_changed(history->note))
+    history->held = 0;
+  else
+    history->held++;
+  history->frame++;
+}
+
+cl_error cl_memory_history_query(cl_counter_t *value,
+  const cl_memory_history_t *history, cl_history_stat stat)
+{
+  if (!value || !history)
     return CL_ERR_PARAMETER_NULL;
+  else if (history->count == 0)
+    return CL_ERR_CLIENT_RUNTIME;
 
-  error = cl_memnote_resolve_ptrs(note);
-  if (error != CL_OK)
-    return error;
+  switch (stat)
+  {
+  case CL_HISTORY_MIN:
+    *value = history->values[history->min_deque[history->min_head] %
+      history->length];
+    break;
+  case CL_HISTORY_MAX:
+    *value = history->values[history->max_deque[history->max_head] %
+      history->length];
+    break;
+  case CL_HISTORY_SUM:
+    *value = history->sum;
+    break;
+  case CL_HISTORY_HELD:
+    cl_ctr_store_int(value, history->held);
+    break;
+  default:
+    return CL_ERR_PARAMETER_INVALID;
+  }
 
-  new_val = 0;
+  return CL_OK;
+}
 
-  /* The "previous" value is the value from the previous frame */
-  note->previous = note->current;
+cl_error cl_memory_trace_init(cl_memory_trace_t *trace)
+{
+  unsigned i;
 
-  cl_read_memory_value(&new_val, CL_NULL, note->address, note->type);
-  cl_ctr_store(&note->current, &new_val, note->type);
+  if (!trace)
+    return CL_ERR_PARAMETER_NULL;
+  memset(trace, 0, sizeof(*trace));
+  if (memory.note_count == 0)
+    return CL_OK;
 
-  /* Logic for "last unique" values; the previous value will persist */
-  if (cl_ctr_equal_exact(&note->previous, &note->current) != CL_OK)
-    note->last_unique = note->previous;
+  trace->keys = (unsigned*)malloc(memory.note_count * sizeof(unsigned));
+  if (!trace->keys)
+    return CL_ERR_CLIENT_RUNTIME;
+  for (i = 0; i < memory.note_count; i++)
+    trace->keys[i] = memory.notes[i].key;
+  trace->note_count = memory.note_count;
 
   return CL_OK;
 }
 
+cl_error cl_memory_trace_record(cl_memory_trace_t *trace)
+{
+  unsigned i;
+
+  if (!trace)
+    return CL_ERR_PARAMETER_NULL;
+  else if (trace->note_count == 0)
+    return CL_OK;
+  else if (trace == memory.replay)
+    return CL_ERR_PARAMETER_INVALID;
+
+  if (trace->frame_count == trace->frame_capacity)
+  {
+    unsigned capacity = trace->frame_capacity ? trace->frame_capacity * 2 : 64;
+    cl_counter_t *values = (cl_counter_t*)realloc(trace->values,
+      (size_t)capacity * trace->note_count * sizeof(cl_counter_t));
+
+    if (!values)
+      return CL_ERR_CLIENT_RUNTIME;
+    trace->values = values;
+    trace->frame_capacity = capacity;
+  }
+
+  /* Notes are looked up by key, in case any were removed since the start */
+  for (i = 0; i < trace->note_count; i++)
+  {
+    cl_counter_t *value =
+      &trace->values[(size_t)trace->frame_count * trace->note_count + i];
+    cl_memnote_t *note = cl_find_memnote(trace->keys[i]);
+
+    if (note)
+      *value = memory.values_current[note - memory.notes];
+    else if (trace->frame_count > 0)
+      *value = trace->values[
+        (size_t)(trace->frame_count - 1) * trace->note_count + i];
+    else
+      memset(value, 0, sizeof(*value));
+  }
+  trace->frame_count++;
+
+  return CL_OK;
+}
+
+cl_error cl_memory_trace_replay(cl_memory_trace_t *trace)
+{
+  unsigned i;
+
+  if (!trace)
+  {
+    memory.replay = CL_NULL;
+    return CL_OK;
+  }
+
+  free(trace->indices);
+  trace->indices = CL_NULL;
+  if (trace->note_count > 0)
+  {
+    trace->indices = (unsigned*)malloc(trace->note_count * sizeof(unsigned));
+    if (!trace->indices)
+      return CL_ERR_CLIENT_RUNTIME;
+  }
+  for (i = 0; i < trace->note_count; i++)
+  {
+    cl_memnote_t *note = cl_find_memnote(trace->keys[i]);
+
+    trace->indices[i] = note ? (unsigned)(note - memory.notes) : UINT_MAX;
+  }
+  trace->position = 0;
+  memory.replay = trace;
+
+  return CL_OK;
+}
+
+void cl_memory_trace_free(cl_memory_trace_t *trace)
+{
+  if (!trace)
+    return;
+  else if (memory.replay == trace)
+    memory.replay = CL_NULL;
+  free(trace->keys);
+  free(trace->values);
+  free(trace->indices);
+  memset(trace, 0, sizeof(*trace));
+}
+
+/* Stores the values of the next frame of the trace being replayed */
+static void cl_memory_trace_step(cl_memory_trace_t *trace)
+{
+  const cl_counter_t *values;
+  unsigned i;
+
+  if (trace->position >= trace->frame_count)
+    return;
+  values = &trace->values[(size_t)trace->position * trace->note_count];
+  for (i = 0; i < trace->note_count; i++)
+  {
+    unsigned index = trace->indices[i];
+
+    if (index >= memory.note_count)
+      continue;
+    memory.values_previous[index] = memory.values_current[index];
+    memory.values_current[index] = values[i];
+    cl_memnote_stored(index);
+  }
+  trace->position++;
+}
+
+#if CL_HAVE_FILESYSTEM
+/* The size of the fixed header at the start of a trace file */
+#define CL_MT_FILE_HEADER_SIZE 16
+
+/* The size of each recorded value in a trace file */
+#define CL_MT_FILE_VALUE_SIZE 17
+
+static cl_bool cl_mt_write_uint(FILE *file, cl_uint64 value, unsigned size)
+{
+  unsigned char bytes[8];
+  unsigned i;
+
+  for (i = 0; i < size; i++)
+    bytes[i] = (unsigned char)(value >> (i * 8));
+
+  return fwrite(bytes, 1, size, file) == size;
+}
+
+static cl_uint64 cl_mt_read_uint(const unsigned char *src, unsigned size)
+{
+  cl_uint64 value = 0;
+  unsigned i;
+
+  for (i = 0; i < size; i++)
+    value |= (cl_uint64)src[i] << (i * 8);
+
+  return value;
+}
+
+cl_error cl_memory_trace_save(const cl_memory_trace_t *trace,
+  const char *path)
+{
+  cl_bool ok;
+  FILE *file;
+  size_t i;
+
+  if (!trace || !path)
+    return CL_ERR_PARAMETER_NULL;
+
+  file = fopen(path, "wb");
+  if (!file)
+    return CL_ERR_CLIENT_RUNTIME;
+
+  ok = fwrite(CL_MEMORY_TRACE_FILE_MAGIC, 1, 4, file) == 4 &&
+       cl_mt_write_uint(file, CL_MEMORY_TRACE_FILE_VERSION, 4) &&
+       cl_mt_write_uint(file, trace->note_count, 4) &&
+       cl_mt_write_uint(file, trace->frame_count, 4);
+  for (i = 0; ok && i < trace->note_count; i++)
+    ok = cl_mt_write_uint(file, trace->keys[i], 4);
+  for (i = 0; ok && i < (size_t)trace->frame_count * trace->note_count; i++)
+  {
+    const cl_counter_t *value = &trace->values[i];
+
+    ok = cl_mt_write_uint(file, (cl_uint64)value->type, 1) &&
+         cl_mt_write_uint(file, value->intval.raw, 8) &&
+         cl_mt_write_uint(file, value->floatval.raw, 8);
+  }
+  if (fclose(file) != 0)
+    ok = CL_FALSE;
+
+  if (ok)
+    cl_log("Saved %u frames of %u memory notes to %s.\n",
+      trace->frame_count, trace->note_count, path);
+
+  return ok ? CL_OK : CL_ERR_CLIENT_RUNTIME;
+}
+
+cl_error cl_memory_trace_load(cl_memory_trace_t *trace, const char *path)
+{
+  const unsigned char *data, *src;
+  cl_addr_t size, offset;
+  unsigned note_count, frame_count;
+  size_t value_count, i;
+
+  if (!trace || !path)
+    return CL_ERR_PARAMETER_NULL;
+  memset(trace, 0, sizeof(*trace));
+
+  data = (const unsigned char*)cl_dma_map_file(path, &size);
+  if (!data)
+    return CL_ERR_PARAMETER_INVALID;
+
+  /* Validate the header and that the file holds every value it claims to */
+  if (size < CL_MT_FILE_HEADER_SIZE ||
+      memcmp(data, CL_MEMORY_TRACE_FILE_MAGIC, 4) != 0 ||
+      cl_mt_read_uint(&data[4], 4) != CL_MEMORY_TRACE_FILE_VERSION)
+    goto error;
+  note_count = (unsigned)cl_mt_read_uint(&data[8], 4);
+  frame_count = (unsigned)cl_mt_read_uint(&data[12], 4);
+  if (note_count == 0 || note_count > CL_MEMNOTE_KEY_MAX + 1 ||
+      (size - CL_MT_FILE_HEADER_SIZE) / 4 < note_count)
+    goto error;
+  offset = CL_MT_FILE_HEADER_SIZE + (cl_addr_t)note_count * 4;
+  if (frame_count > (size - offset) / CL_MT_FILE_VALUE_SIZE / note_count)
+    goto error;
+  value_count = (size_t)frame_count * note_count;
+
+  trace->keys = (unsigned*)malloc(note_count * sizeof(unsigned));
+  trace->values = (cl_counter_t*)malloc(
+    (value_count ? value_count : 1) * sizeof(cl_counter_t));
+  if (!trace->keys || !trace->values)
+    goto error;
+  src = &data[CL_MT_FILE_HEADER_SIZE];
+  for (i = 0; i < note_count; i++, src += 4)
+    trace->keys[i] = (unsigned)cl_mt_read_uint(src, 4);
+  for (i = 0; i < value_count; i++, src += CL_MT_FILE_VALUE_SIZE)
+  {
+    cl_counter_t *value = &trace->values[i];
+
+    value->type = (cl_value_type)src[0];
+    value->intval.raw = cl_mt_read_uint(&src[1], 8);
+    value->floatval.raw = cl_mt_read_uint(&src[9], 8);
+  }
+  trace->note_count = note_count;
+  trace->frame_count = frame_count;
+  trace->frame_capacity = frame_count;
+  cl_dma_unmap_file(data, size);
+
+  cl_log("Loaded %u frames of %u memory notes from %s.\n",
+    frame_count, note_count, path);
+
+  return CL_OK;
+
+error:
+  cl_dma_unmap_file(data, size);
+  cl_memory_trace_free(trace);
+
+  return CL_ERR_PARAMETER_INVALID;
+}
+#endif
+
 void cl_update_memory(void)
 {
   /* Have memory banks not been set up yet? */
   /* TODO: Maybe we should attempt to set up membanks here, like before */
-  if (memory.region_count == 0)
+  if (memory.region_count == 0 && !memory.replay)
     return;
   else
   {
+#if !CL_EXTERNAL_MEMORY
     unsigned i;
+#endif
+    unsigned j;
 
-    for (i = 0; i < memory.note_count; i++)
-      cl_update_memnote(&memory.notes[i]);
+    memory.frame++;
+    if (memory.changed)
+      memset(memory.changed, 0, (memory.note_count + 7) / 8);
+    memory.changed_count = 0;
+    if (memory.replay)
+      cl_memory_trace_step(memory.replay);
+    else
+    {
+      cl_memory_mark_chains();
+#if CL_EXTERNAL_MEMORY
+      cl_memory_update_batched();
+#else
+      cl_memory_update_chains();
+      for (i = 0; i < memory.note_count; i++)
+        if (cl_memory_note_wanted(i))
+          cl_update_memnote(&memory.notes[i]);
+#endif
+    }
+    for (j = 0; j < memory.history_count; j++)
+      cl_memory_history_push(&memory.histories[j]);
+    memory.include_flags = 0;
   }
 }
 
-cl_error cl_write_memnote(cl_memnote_t *note, const cl_counter_t *value)
+/* One value waiting to be written to memory */
+typedef struct cl_memory_write_t
 {
-  cl_error error;
+  cl_addr_t address;
+  unsigned size;
+
+  /* The order the write was queued in, so later writes win */
+  unsigned order;
+
+  /* The region the value is in */
+  const cl_memory_region_t *region;
+
+  /* The value, already in the region's byte order */
+  unsigned char bytes[8];
+} cl_memory_write_t;
+
+void cl_memory_write_queue_free(cl_memory_write_queue_t *queue)
+{
+  free(queue->writes);
+  queue->writes = CL_NULL;
+  queue->count = 0;
+  queue->capacity = 0;
+}
+
+/**
+ * Converts a double to an integer, saturating at the limits of the type, as
+ * converting an out of range value is undefined. NaN becomes 0.
+ */
+static cl_int64 cl_memory_double_to_int(double d)
+{
+  const cl_int64 max = (cl_int64)(~(cl_uint64)0 >> 1);
+
+  if (d != d)
+    return 0;
+  else if (d >= 9223372036854775808.0)
+    return max;
+  else if (d < -9223372036854775808.0)
+    return -max - 1;
+  else
+    return (cl_int64)d;
+}
+
+/* Converts a counter to a value of the given type, in host byte order */
+static void cl_memory_pack_value(void *dst, const cl_counter_t *value,
+  cl_value_type type)
+{
+  cl_bool is_float = cl_ctr_is_float(value);
+  cl_int64 i = is_float ? cl_memory_double_to_int(value->floatval.fp) :
+    value->intval.i64;
+  double d = is_float ? value->floatval.fp : (double)value->intval.i64;
+
+  switch (type)
+  {
+  case CL_MEMTYPE_INT8:
+  case CL_MEMTYPE_UINT8:
+    *(uint8_t*)dst = (uint8_t)i;
+    break;
+  case CL_MEMTYPE_INT16:
+  case CL_MEMTYPE_UINT16:
+    *(uint16_t*)dst = (uint16_t)i;
+    break;
+  case CL_MEMTYPE_INT32:
+  case CL_MEMTYPE_UINT32:
+    *(uint32_t*)dst = (uint32_t)i;
+    break;
+  case CL_MEMTYPE_FLOAT:
+    /* Finite doubles out of the range of a float are also undefined */
+    if (d > FLT_MAX)
+      d = FLT_MAX;
+    else if (d < -FLT_MAX)
+      d = -FLT_MAX;
+    *(float*)dst = (float)d;
+    break;
+  case CL_MEMTYPE_INT64:
+    *(cl_int64*)dst = i;
+    break;
+  case CL_MEMTYPE_DOUBLE:
+    *(double*)dst = d;
+    break;
+  case CL_MEMTYPE_NOT_SET:
+  case CL_MEMTYPE_SIZE:
+    break;
+  }
+}
+
+cl_error cl_write_memnote(cl_memory_write_queue_t *queue, cl_memnote_t *note,
+  const cl_counter_t *value)
+{
+  const cl_memory_region_t *region;
+  cl_memory_write_t *write;
+  double typed;
 
-  if (!note || !value)
+  if (!queue || !note || !value)
    return CL_ERR_PARAMETER_NULL;
 
-  error = cl_memnote_resolve_ptrs(note);
-  if (error != CL_OK)
-    return error;
+  /* Reuse the address resolved by this frame's update, if there was one */
+  if (note->resolved_frame != memory.frame || memory.frame == 0)
+  {
+    cl_error error = cl_memnote_resolve_ptrs(note);
+
+    if (error != CL_OK)
+      return error;
+    note->resolved_frame = memory.frame;
+  }
+
+  region = cl_find_memory_region(note->address);
+  if (!region || note->address < region->base_guest ||
+      note->address - region->base_guest + cl_sizeof_memtype(note->type) >
+      region->size)
+    return CL_ERR_PARAMETER_INVALID;
+  else if (queue->count == queue->capacity)
+  {
+    unsigned capacity = queue->capacity ? queue->capacity * 2 : 16;
+    cl_memory_write_t *writes = (cl_memory_write_t*)realloc(queue->writes,
+      capacity * sizeof(cl_memory_write_t));
+
+    if (!writes)
+      return CL_ERR_CLIENT_RUNTIME;
+    queue->writes = writes;
+    queue->capacity = capacity;
+  }
+
+  write = &queue->writes[queue->count];
+  write->address = note->address;
+  write->size = cl_sizeof_memtype(note->type);
+  write->order = queue->count;
+  write->region = region;
+  cl_memory_pack_value(&typed, value, note->type);
+  if (cl_write_value(&typed, write->bytes, 0, note->type,
+        region->endianness) != CL_OK)
+    return CL_ERR_PARAMETER_INVALID;
+  queue->count++;
+
+  return CL_OK;
+}
+
+static int cl_memory_write_compare_address(const void *a, const void *b)
+{
+  const cl_memory_write_t *left = (const cl_memory_write_t*)a;
+  const cl_memory_write_t *right = (const cl_memory_write_t*)b;
+
+  if (left->address != right->address)
+    return left->address < right->address ? -1 : 1;
+  else
+    return left->order < right->order ? -1 : left->order > right->order;
+}
+
+static int cl_memory_write_compare_order(const void *a, const void *b)
+{
+  const cl_memory_write_t *left = (const cl_memory_write_t*)a;
+  const cl_memory_write_t *right = (const cl_memory_write_t*)b;
+
+  return left->order < right->order ? -1 : left->order > right->order;
+}
+
+cl_error cl_memory_flush_writes(cl_memory_write_queue_t *queue)
+{
+  unsigned char run[CL_MEMORY_WRITE_RUN_SIZE];
+  cl_memory_write_t *writes = queue->writes;
+  cl_error error = CL_OK;
+  unsigned i = 0;
+
+  /* Most frames queue nothing, and the queue is not allocated until used */
+  if (!queue->count)
+    return CL_OK;
+  qsort(writes, queue->count, sizeof(cl_memory_write_t),
+    cl_memory_write_compare_address);
+  while (i < queue->count)
+  {
+    const cl_memory_region_t *region = writes[i].region;
+    cl_addr_t start = writes[i].address;
+    cl_addr_t end = start + writes[i].size;
+    unsigned char *buffer = run;
+    unsigned j;
+
+    /**
+     * Gather every write touching or overlapping this run of memory. A run
+     * is only split between writes that do not overlap, so overlapping
+     * writes are always applied together in the order they were queued.
+     */
+    for (j = i + 1; j < queue->count; j++)
+    {
+      const cl_memory_write_t *write = &writes[j];
+
+      if (write->region != region || write->address > end ||
+          (write->address == end &&
+           write->address + write->size - start > sizeof(run)))
+        break;
+      if (write->address + write->size > end)
+        end = write->address + write->size;
+    }
+
+    /* Long chains of overlapping writes can outgrow the run buffer */
+    if (end - start > sizeof(run))
+      buffer = (unsigned char*)malloc(end - start);
+    if (!buffer)
+    {
+      error = CL_ERR_CLIENT_RUNTIME;
+      i = j;
+      continue;
+    }
+
+    /* Apply them in the order they were queued, so the last one wins */
+    qsort(&writes[i], j - i, sizeof(cl_memory_write_t),
+      cl_memory_write_compare_order);
+    for (; i < j; i++)
+      memcpy(&buffer[writes[i].address - start], writes[i].bytes,
+        writes[i].size);
+    if (cl_write_memory_buffer(buffer, region, start - region->base_guest,
+          end - start) != CL_OK)
+      error = CL_ERR_CLIENT_RUNTIME;
+    if (buffer != run)
+      free(buffer);
+  }
+  queue->count = 0;
 
-  return cl_write_memory_value(cl_ctr_is_float(value) == CL_OK ?
-    (const void *)&value->floatval.fp : (const void *)&value->intval.i64,
-    CL_NULL, note->address, note->type);
+  return error;
 }
 
-cl_error cl_write_memnote_from_key(unsigned key, const cl_counter_t *value)
+cl_error cl_write_memnote_from_key(cl_memory_write_queue_t *queue,
+  unsigned key, const cl_counter_t *value)
 {
   cl_memnote_t *note = cl_find_memnote(key);
 
   if (!note)
     return CL_ERR_PARAMETER_NULL;
   else
-    return cl_write_memnote(note, value);
+    return cl_write_memnote(queue, note, value);
 }
@@ -20,16 +20,127 @@ typedef enum
 
 /**
  * Looks up which memory bank a given virtual address is contained in.
+ * The global memory regions must be sorted by `cl_sort_memory_regions`.
  * @param address A virtual memory address.
  * @return A pointer to the memory bank, or NULL if one is not found.
  */
 cl_memory_region_t* cl_find_memory_region(cl_addr_t address);
 
+/**
+ * Looks up which memory bank a given virtual address is contained in,
+ * checking the bank found by the caller's previous lookup first. Reads tend
+ * to hit the same bank many times in a row. The hint is owned by the
+ * caller, so lookups from different threads never share one.
+ * @param address A virtual memory address.
+ * @param hint The index of the bank last found, updated when a bank is
+ *   found. Any value can be passed in; a stale one is only ever a miss.
+ * @return A pointer to the memory bank, or NULL if one is not found.
+ */
+cl_memory_region_t* cl_find_memory_region_hint(cl_addr_t address,
+  unsigned *hint);
+
+/**
+ * Sorts memory regions by their guest base address.
+ * @param banks An array of memory regions.
+ * @param count The number of memory regions in the array.
+ */
+void cl_sort_memory_regions(cl_memory_region_t *banks, unsigned count);
+
 /**
  * Frees all values contained within the global memory context.
  */
 void cl_memory_free(void);
 
+/**
+ * A copy of every memory region taken at one point in time, so that
+ * operations which read memory many times see consistent values and do not
+ * need to go through the external memory interface on each read.
+ */
+typedef struct
+{
+  /**
+   * Copies of the memory regions, with `base_host` pointing into the
+   * snapshot's data. Pass these to the `_internal` memory functions.
+   */
+  cl_memory_region_t *regions;
+  unsigned region_count;
+
+  /**
+   * A single pooled mapping holding the data of every region, or NULL if the
+   * regions are read in place, as with internal memory.
+   */
+  void *data;
+
+  /* The size, in bytes, of `data` */
+  cl_addr_t size;
+} cl_memory_snapshot_t;
+
+/**
+ * A function deciding whether a memory region should be included in an
+ * operation.
+ * @param region A pointer to the memory region
+ * @param userdata The userdata given alongside the function
+ * @return CL_TRUE if the region should be included
+ */
+typedef cl_bool (*cl_memory_region_filter_t)(const cl_memory_region_t *region,
+  const void *userdata);
+
+/**
+ * Takes a snapshot of memory regions. The global memory regions are not
+ * modified.
+ * @param snapshot A pointer to the snapshot to initialize
+ * @param filter A function deciding which regions to include, or NULL to
+ *   include all of them. Excluded regions are not read at all.
+ * @param userdata Passed to `filter`
+ * @return CL_OK if the snapshot was taken; error code otherwise.
+ */
+cl_error cl_memory_snapshot_init(cl_memory_snapshot_t *snapshot,
+  cl_memory_region_filter_t filter, const void *userdata);
+
+/**
+ * Copies the current contents of a snapshot's regions into its pooled
+ * buffer. The buffer is allocated on the first capture and reused after, so a
+ * snapshot can be captured again at every frame boundary without allocating.
+ * After capturing, the snapshot no longer reads internal memory in place.
+ * @param snapshot A pointer to a snapshot initialized by
+ *   `cl_memory_snapshot_init`
+ * @return CL_OK if the snapshot was captured; error code otherwise.
+ */
+cl_error cl_memory_snapshot_capture(cl_memory_snapshot_t *snapshot);
+
+/**
+ * A range of guest memory.
+ */
+typedef struct
+{
+  /* The virtual address of the first byte in the range */
+  cl_addr_t address;
+
+  /* The size, in bytes, of the range */
+  cl_addr_t size;
+} cl_memory_range_t;
+
+/**
+ * Finds every range of memory that differs between two snapshots of the
+ * same regions, such as the same snapshot captured on two frames.
+ * @param before A pointer to the earlier snapshot
+ * @param after A pointer to the later snapshot
+ * @param ranges Set to a new array of the changed ranges in address order, or
+ *   NULL if nothing changed. Free it with `cl_dma_free`.
+ * @param range_count Set to the number of changed ranges
+ * @return CL_OK on success, or an error code if the snapshots do not hold the
+ *   same regions.
+ */
+cl_error cl_memory_snapshot_diff(const cl_memory_snapshot_t *before,
+  const cl_memory_snapshot_t *after, cl_memory_range_t **ranges,
+  unsigned *range_count);
+
+/**
+ * Frees all memory held by a snapshot.
+ * @param snapshot A pointer to the snapshot to free
+ */
+void cl_memory_snapshot_free(cl_memory_snapshot_t *snapshot);
+
 /**
  * Frees a memory note. Called automatically as part of cl_free_memory.
  * @param note The memory note to be freed.
@@ -70,6 +181,163 @@ cl_error cl_get_memnote_value(cl_counter_t *value, cl_memnote_t *note,
 cl_error cl_get_memnote_value_from_key(cl_counter_t *value, unsigned key,
   cl_src_t type);
 
+/**
+ * Returns where a value of a memory note is stored, so it can be read each
+ * frame without looking up the note again. The pointer is invalidated when
+ * memory notes are added.
+ * @param key The key of the memory note.
+ * @param type The source type of the value. For example, CL_SRC_CURRENT_RAM.
+ * @return A pointer to the value, or NULL if the note does not exist.
+ **/
+cl_counter_t *cl_memory_note_value(unsigned key, cl_src_t type);
+
+/**
+ * Returns whether a memory note's value changed on the last update.
+ * @param index The index of the memory note in the global memory context.
+ **/
+cl_bool cl_memory_note_changed(unsigned index);
+
+/**
+ * Starts tracking which memory notes the script reads. Until this is called,
+ * every note is updated; after, only notes passed to
+ * `cl_memory_reference_note`, flagged with `cl_memory_reference_flag`, or
+ * included by `cl_memory_include_flag` are.
+ * @return CL_OK on success, or an error code on failure.
+ **/
+cl_error cl_memory_reset_references(void);
+
+/**
+ * Marks a memory note as read by the script, so it is updated every frame.
+ * @param key The key of the memory note.
+ * @return CL_OK on success, or an error code if no note has the key.
+ **/
+cl_error cl_memory_reference_note(unsigned key);
+
+/**
+ * Includes every memory note with a flag in the next update, even if the
+ * script does not read them. For example, CL_MEMFLAG_RICH notes are only
+ * needed when a presence update is about to be sent.
+ * @param flag The memory note flag.
+ **/
+void cl_memory_include_flag(cl_memnote_flag flag);
+
+/**
+ * Marks every memory note with a flag as read by the script, including notes
+ * added later. For example, CL_MEMFLAG_RICH notes are sent with every post
+ * to the website, so scripts that post read them every frame.
+ * @param flag The memory note flag.
+ **/
+void cl_memory_reference_flag(cl_memnote_flag flag);
+
+/**
+ * Requests that a window of recent values be kept for a memory note, so its
+ * statistics can be queried with `cl_memory_history_query`. Requesting a
+ * window that already exists does nothing. Adding a window clears the values
+ * recorded by every other window, so all requests should be made on load.
+ * @param key The key of the memory note.
+ * @param frames The length of the window, up to `CL_MEMORY_HISTORY_MAX`.
+ * @return CL_OK on success, or an error code on failure.
+ **/
+cl_error cl_memory_history_request(unsigned key, unsigned frames);
+
+/**
+ * Returns the window of recent values kept for a memory note, or NULL if one
+ * of that length was never requested.
+ * @param key The key of the memory note.
+ * @param frames The length of the window.
+ **/
+cl_memory_history_t *cl_memory_history_find(unsigned key, unsigned frames);
+
+/**
+ * Returns a window of recent values by its index in `memory.histories`, or
+ * NULL if there is none. Unlike pointers, indices stay valid when more
+ * windows are requested.
+ * @param index The index of the window.
+ **/
+cl_memory_history_t *cl_memory_history_at(unsigned index);
+
+/**
+ * Copies a statistic of a memory note's recent values into a counter. Each
+ * statistic is kept up to date as values are recorded, so this takes
+ * constant time.
+ * @param value A counter for the statistic to be copied into.
+ * @param history A window of recent values.
+ * @param stat The statistic to copy. For example, CL_HISTORY_MAX.
+ * @return CL_OK on success, or an error code if no values are recorded yet.
+ **/
+cl_error cl_memory_history_query(cl_counter_t *value,
+  const cl_memory_history_t *history, cl_history_stat stat);
+
+/**
+ * Starts a trace of the values of every memory note in the global memory
+ * context. Notes added afterward are not recorded.
+ * @param trace A pointer to the trace to initialize.
+ * @return CL_OK on success, or an error code on failure.
+ **/
+cl_error cl_memory_trace_init(cl_memory_trace_t *trace);
+
+/**
+ * Appends the current values of the traced memory notes to a trace as its
+ * next frame. Should be called after each `cl_update_memory`.
+ * @param trace A pointer to the trace to record into.
+ * @return CL_OK on success, or an error code on failure.
+ **/
+cl_error cl_memory_trace_record(cl_memory_trace_t *trace);
+
+/**
+ * Makes `cl_update_memory` take the values of memory notes from a trace,
+ * one frame per update from the first, instead of reading memory. Notes are
+ * matched by key; notes the trace does not have keep their last values, as do
+ * all notes once every frame has been replayed. Memory regions do not need to
+ * be set up while replaying.
+ * @param trace A pointer to the trace to replay, or NULL to read memory again.
+ * @return CL_OK on success, or an error code on failure.
+ **/
+cl_error cl_memory_trace_replay(cl_memory_trace_t *trace);
+
+/**
+ * Frees the values held by a trace, and stops replaying it if it is being
+ * replayed.
+ * @param trace A pointer to the trace to free.
+ **/
+void cl_memory_trace_free(cl_memory_trace_t *trace);
+
+#if CL_HAVE_FILESYSTEM
+/**
+ * The identifier at the start of a memory trace file.
+ */
+#define CL_MEMORY_TRACE_FILE_MAGIC "CLMT"
+
+/**
+ * The version of the memory trace file format. Files with another version
+ * are rejected.
+ */
+#define CL_MEMORY_TRACE_FILE_VERSION 1
+
+/**
+ * Writes a trace to a file so it can be replayed in a later session.
+ *
+ * All fields are little-endian. The file is laid out as:
+ * - The magic, version, note count and frame count as 4-byte values.
+ * - The key of each note as a 4-byte value.
+ * - For each frame, the value of each note as its type as a 1-byte value,
+ *   then its integer and floating point parts as 8-byte values.
+ * @param trace A pointer to the trace.
+ * @param path The path of the file to write.
+ * @return CL_OK on success, or an error code on failure.
+ **/
+cl_error cl_memory_trace_save(const cl_memory_trace_t *trace,
+  const char *path);
+
+/**
+ * Initializes a trace from a file written by `cl_memory_trace_save`.
+ * @param trace A pointer to the trace to initialize.
+ * @param path The path of the file to read.
+ * @return CL_OK on success, or an error code on failure.
+ **/
+cl_error cl_memory_trace_load(cl_memory_trace_t *trace, const char *path);
+#endif
+
 /* Populate a memory holder with values returned by the web API */
 cl_error cl_init_memory(const char **pos);
 
@@ -130,19 +398,53 @@ cl_error cl_write_memory_value_external(const void *buffer,
 
 /**
  * Steps through all memory notes and updates their values. Should be called 
- * once per frame.
+ * once per frame. If a trace is being replayed, the values are taken from it
+ * instead; see `cl_memory_trace_replay`.
  **/
 void cl_update_memory(void);
 
 /**
- * Writes the value referenced by a memory note with a given value.
+ * Memory note writes waiting to be applied. Each script has its own queue,
+ * so scripts updated at the same time do not share one. A zeroed queue is
+ * empty.
+ */
+typedef struct
+{
+  struct cl_memory_write_t *writes;
+  unsigned count;
+  unsigned capacity;
+} cl_memory_write_queue_t;
+
+/**
+ * Queues a write of a given value to the memory referenced by a memory note.
+ * The value is converted to the note's type now, but is only written to
+ * memory by `cl_memory_flush_writes`.
+ * @param queue The queue to add the write to.
  * @param note A pointer to a memory note.
  * @param key The unique key of a memory note.
  * @param value A buffer containing the source value.
- * @return CL_OK if the write succeeded; error code otherwise.
+ * @return CL_OK if the write was queued; error code otherwise.
+ **/
+cl_error cl_write_memnote(cl_memory_write_queue_t *queue, cl_memnote_t *note,
+  const cl_counter_t *value);
+cl_error cl_write_memnote_from_key(cl_memory_write_queue_t *queue,
+  unsigned key, const cl_counter_t *value);
+
+/**
+ * Writes every write in a queue to memory, in address order, then empties
+ * it. Later writes to the same address replace earlier ones, and writes to
+ * adjacent addresses are merged into one buffer write. Called at the end of
+ * `cl_script_update` with the script's queue.
+ * @param queue The queue to apply.
+ * @return CL_OK if every write succeeded; error code otherwise.
  **/
-cl_error cl_write_memnote(cl_memnote_t *note, const cl_counter_t *value);
-cl_error cl_write_memnote_from_key(unsigned key, const cl_counter_t *value);
+cl_error cl_memory_flush_writes(cl_memory_write_queue_t *queue);
+
+/**
+ * Frees the memory held by a write queue, discarding any queued writes.
+ * @param queue The queue to free.
+ **/
+void cl_memory_write_queue_free(cl_memory_write_queue_t *queue);
 
 /**
  * Looks up a memory note based on its key.
@@ -159,6 +461,12 @@ cl_memnote_t* cl_find_memnote(unsigned key);
  */
 cl_error cl_memory_add_note(const cl_memnote_t *note);
 
+/**
+ * Builds the read plan of every memory note in the global memory context. This
+ * must be called again whenever the memory regions are reinstalled.
+ */
+void cl_memory_compile_notes(void);
+
 /**
  * Verifies and initializes all memory notes in the global memory context.
  * Prints information about each note to the log.
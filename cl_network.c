@@ -38,7 +38,7 @@ static char *cl_build_generic_post_data(void)
       {
         unsigned written, need;
 
-        if (cl_ctr_is_float(&note->current))
+        if (cl_ctr_is_float(&value))
           written = snprintf(temp, sizeof(temp), "&m%u=%f",
                              note->key, value.floatval.fp);
         else
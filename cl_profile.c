@@ -0,0 +1,59 @@
+/* clock_gettime is only declared when POSIX extensions are enabled */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "cl_profile.h"
+
+#if CL_HOST_PLATFORM == _CL_PLATFORM_WINDOWS
+#include <windows.h>
+#elif CL_HOST_PLATFORM == _CL_PLATFORM_LINUX || \
+      CL_HOST_PLATFORM == _CL_PLATFORM_MACOS || \
+      CL_HOST_PLATFORM == _CL_PLATFORM_ANDROID
+#include <time.h>
+#define CL_PROFILE_MONOTONIC 1
+#else
+#include <time.h>
+#endif
+
+cl_uint64 cl_profile_ticks(void)
+{
+#if CL_HOST_PLATFORM == _CL_PLATFORM_WINDOWS
+  LARGE_INTEGER counter;
+
+  QueryPerformanceCounter(&counter);
+
+  return (cl_uint64)counter.QuadPart;
+#elif CL_PROFILE_MONOTONIC
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (cl_uint64)now.tv_sec * 1000000000 + (cl_uint64)now.tv_nsec;
+#else
+  return (cl_uint64)clock();
+#endif
+}
+
+double cl_profile_seconds(cl_uint64 ticks)
+{
+#if CL_HOST_PLATFORM == _CL_PLATFORM_WINDOWS
+  LARGE_INTEGER frequency;
+
+  QueryPerformanceFrequency(&frequency);
+
+  return (double)ticks / (double)frequency.QuadPart;
+#elif CL_PROFILE_MONOTONIC
+  return (double)ticks / 1000000000.0;
+#else
+  return (double)ticks / CLOCKS_PER_SEC;
+#endif
+}
+
+void cl_profile_add(cl_profile_t *profile, cl_uint64 ticks)
+{
+  profile->total += ticks;
+  if (ticks > profile->max)
+    profile->max = ticks;
+  profile->count++;
+}
@@ -0,0 +1,40 @@
+#ifndef CL_PROFILE_H
+#define CL_PROFILE_H
+
+#include "cl_types.h"
+
+/**
+ * Timing statistics for one part of a script. These are only collected when
+ * built with CL_HAVE_PROFILER.
+ */
+typedef struct
+{
+  /* The total time spent, in ticks */
+  cl_uint64 total;
+
+  /* The longest single run, in ticks */
+  cl_uint64 max;
+
+  /* The number of runs */
+  unsigned count;
+} cl_profile_t;
+
+/**
+ * Returns the current value of a monotonic timer, in ticks. Use
+ * `cl_profile_seconds` to convert a difference of ticks into time.
+ */
+cl_uint64 cl_profile_ticks(void);
+
+/**
+ * Converts a number of ticks from `cl_profile_ticks` into seconds.
+ */
+double cl_profile_seconds(cl_uint64 ticks);
+
+/**
+ * Adds a single run to a set of timing statistics.
+ * @param profile The statistics to add to.
+ * @param ticks The length of the run, in ticks.
+ */
+void cl_profile_add(cl_profile_t *profile, cl_uint64 ticks);
+
+#endif
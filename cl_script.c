@@ -2,9 +2,13 @@
 
 #include "cl_abi.h"
 #include "cl_dma.h"
+#include "cl_memory.h"
 
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 cl_script_t script;
 
@@ -19,26 +23,389 @@ static void cl_page_free(cl_page_t *page)
   cl_dma_free(page->actions);
   page->actions = NULL;
   page->action_count = 0;
-  cl_dma_free(page);
+  cl_dma_free(page->steps);
+  page->steps = NULL;
+  page->step_count = 0;
+  cl_dma_free(page->setup);
+  page->setup = NULL;
+  page->setup_count = 0;
+  cl_dma_free(page->inputs);
+  page->inputs = NULL;
+  page->inputs_size = 0;
 }
 
-void cl_script_free(void)
+void cl_script_free(cl_script_t *script)
 {
   unsigned i;
 
-  for (i = 0; i < script.page_count; i++)
-    cl_page_free(&script.pages[i]);
-  script.pages = NULL;
-  script.page_count = 0;
+  for (i = 0; i < script->page_count; i++)
+    cl_page_free(&script->pages[i]);
+  cl_dma_free(script->pages);
+  script->pages = NULL;
+  script->page_count = 0;
+  cl_dma_free(script->counters);
+  script->counters = NULL;
+  script->counter_count = 0;
+  cl_memory_write_queue_free(&script->writes);
 }
 
-static cl_error cl_init_page(const char **pos, cl_page_t *page)
+/* What the analysis of a page decided to do with each of its actions */
+typedef enum
 {
-  cl_action_t *action      = NULL;
-  cl_action_t *prev_action = NULL;
-  unsigned     i, j;
+  /* The action is compiled into a step and run every frame */
+  CL_FATE_RUN = 0,
+
+  /* The action is nested under a condition that always fails */
+  CL_FATE_DEAD,
+
+  /* The action is a condition that always passes */
+  CL_FATE_PASS,
+
+  /* The action is run once when the script is loaded */
+  CL_FATE_SETUP
+} cl_action_fate;
+
+/**
+ * Finds the end of the chain of conditions starting at an action, then the
+ * end of the block nested under it. A chain of conditions is a run of
+ * conditions at the same indentation, and the block nested under it is the
+ * actions after it that are indented further.
+ * @param chain_end Set to the index after the last condition of the chain.
+ * @return The index after the last action of the block.
+ */
+static unsigned cl_page_block_end(const cl_page_t *page, unsigned i,
+  unsigned *chain_end)
+{
+  unsigned indentation = page->actions[i].indentation;
+  unsigned end, j;
+
+  for (end = i; end < page->action_count &&
+       page->actions[end].if_type &&
+       page->actions[end].indentation == indentation; end++);
+  for (j = end; j < page->action_count &&
+       page->actions[j].indentation > indentation; j++);
+  *chain_end = end;
+
+  return j;
+}
+
+/**
+ * Returns whether an invariant action is the only one on its page that
+ * modifies its counter, and no action before it reads the counter, so the
+ * counter holds the action's value from the first frame onward.
+ */
+static cl_bool cl_page_counter_invariant(const cl_page_t *page,
+  const unsigned char *fates, unsigned index, unsigned counter)
+{
+  unsigned i;
+
+  for (i = 0; i < page->action_count; i++)
+  {
+    cl_bool modifies;
+
+    if (i != index && fates[i] != CL_FATE_DEAD &&
+        cl_action_uses_counter(&page->actions[i], counter, &modifies) &&
+        (modifies || i < index))
+      return CL_FALSE;
+  }
+
+  return CL_TRUE;
+}
+
+/**
+ * Decides what to do with each action of a page before it is compiled.
+ * Conditions that compare immediates are folded: those that always fail
+ * remove their chain and block, and those that always pass are dropped from
+ * their chain. Unconditional actions that set a counter to an immediate
+ * nothing else changes are hoisted to run once at load. Each finding is
+ * reported with the index of the action.
+ */
+static void cl_page_analyze(const cl_page_t *page, unsigned index,
+  unsigned char *fates)
+{
+  unsigned i, j, k, end, counter;
+
+  memset(fates, CL_FATE_RUN, page->action_count);
+  for (i = 0; i < page->action_count; i++)
+  {
+    if (!page->actions[i].if_type || fates[i] == CL_FATE_DEAD)
+      continue;
+    j = cl_page_block_end(page, i, &end);
+    for (k = i; k < end; k++)
+    {
+      cl_bool pass;
+
+      if (!cl_action_constant(&page->actions[k], &pass))
+        continue;
+      else if (pass)
+      {
+        cl_message(CL_MSG_WARN, "Page %u action %u: condition always "
+          "passes.", index, k);
+        fates[k] = CL_FATE_PASS;
+      }
+      else
+      {
+        cl_message(CL_MSG_WARN, "Page %u action %u: condition never "
+          "passes, so actions %u to %u never run.", index, k, i, j - 1);
+        memset(&fates[i], CL_FATE_DEAD, j - i);
+        break;
+      }
+    }
+
+    /* The block itself is analyzed as the loop continues */
+    i = end - 1;
+  }
+
+  for (i = 0; i < page->action_count; i++)
+  {
+    if (page->actions[i].if_type)
+    {
+      /* Only actions that run every frame are hoisted */
+      i = cl_page_block_end(page, i, &end) - 1;
+      continue;
+    }
+    else if (fates[i] == CL_FATE_RUN &&
+             cl_action_invariant(&page->actions[i], &counter) &&
+             cl_page_counter_invariant(page, fates, i, counter))
+    {
+      cl_message(CL_MSG_DEBUG, "Page %u action %u: counter %u is only set "
+        "once, when the script is loaded.", index, i, counter);
+      fates[i] = CL_FATE_SETUP;
+    }
+  }
+
+#if CL_HAVE_EDITOR
+  /* The editor runs every action as written, so it can show and edit them */
+  memset(fates, CL_FATE_RUN, page->action_count);
+#endif
+}
+
+/**
+ * Compiles the actions of a page into steps, leaving out those the analysis
+ * found do not need to run every frame. If any condition in a chain fails,
+ * execution skips to the end of the chain's block.
+ */
+static cl_error cl_page_compile(cl_page_t *page, const unsigned char *fates)
+{
+  unsigned *first;
+  unsigned i, j, k, end;
+
+  page->steps = (cl_step_t*)cl_dma_alloc(
+    page->action_count * sizeof(cl_step_t) + 1, CL_FALSE);
+  page->setup = (cl_action_t**)cl_dma_alloc(
+    page->action_count * sizeof(cl_action_t*) + 1, CL_FALSE);
+  first = (unsigned*)cl_dma_alloc(
+    (page->action_count + 1) * sizeof(unsigned), CL_FALSE);
+  if (!page->steps || !page->setup || !first)
+  {
+    cl_dma_free(first);
+    return CL_ERR_PARAMETER_NULL;
+  }
+
+  /* Number the steps, keeping the first step at or after each action */
+  page->step_count = 0;
+  page->setup_count = 0;
+  for (i = 0; i < page->action_count; i++)
+  {
+    first[i] = page->step_count;
+    if (fates[i] == CL_FATE_RUN)
+    {
+      cl_step_t *step = &page->steps[page->step_count++];
+
+      step->action = &page->actions[i];
+      step->skip = page->step_count;
+      step->fused = NULL;
+    }
+    else if (fates[i] == CL_FATE_SETUP)
+      page->setup[page->setup_count++] = &page->actions[i];
+  }
+  first[page->action_count] = page->step_count;
+
+  for (i = 0; i < page->action_count; i++)
+  {
+    if (!page->actions[i].if_type || fates[i] == CL_FATE_DEAD)
+      continue;
+    j = cl_page_block_end(page, i, &end);
+
+    /**
+     * A chain with a single action nested under it may have a fused
+     * handler, if every action from its first remaining condition is run
+     */
+    for (k = i; k < end && fates[k] == CL_FATE_PASS; k++);
+    if (k < end && j == end + 1 && !page->actions[end].if_type)
+    {
+      unsigned m;
+
+      for (m = k; m < j && fates[m] == CL_FATE_RUN; m++);
+      if (m == j)
+        page->steps[first[k]].fused =
+          cl_action_fuse(&page->actions[k], j - k);
+    }
+    for (; i < end; i++)
+      if (fates[i] == CL_FATE_RUN)
+        page->steps[first[i]].skip = first[j];
+
+    /* The block itself is compiled as the loop continues */
+    i--;
+  }
+  cl_dma_free(first);
+
+  return CL_OK;
+}
+
+/**
+ * Finds the memory notes the steps of a page read, and whether it has
+ * actions that must run every frame.
+ */
+static cl_error cl_page_find_inputs(cl_page_t *page)
+{
+  unsigned keys[CL_ACTION_OPERANDS];
+  unsigned i, j, count;
+
+  page->inputs_size = (memory.note_count + 7) / 8;
+  page->inputs = (unsigned char*)cl_dma_alloc(page->inputs_size + 1, CL_TRUE);
+  if (!page->inputs)
+    return CL_ERR_PARAMETER_NULL;
+  page->always_run = CL_FALSE;
+  page->dirty = CL_TRUE;
+
+  for (i = 0; i < page->step_count; i++)
+  {
+    if (cl_action_every_frame(page->steps[i].action))
+      page->always_run = CL_TRUE;
+    count = cl_action_note_keys(page->steps[i].action, keys);
+    for (j = 0; j < count; j++)
+    {
+      const cl_memnote_t *note = cl_find_memnote(keys[j]);
+      unsigned index;
+
+      if (!note)
+        continue;
+      index = (unsigned)(note - memory.notes);
+      page->inputs[index >> 3] |= (unsigned char)(1 << (index & 7));
+    }
+  }
+
+  return CL_OK;
+}
+
+/**
+ * A source of the numbers a script is made of. Scripts are either decimal
+ * text, or the binary encoding described at `cl_script_init_binary`, which
+ * is decoded straight from its base64url text without an intermediate copy.
+ */
+typedef struct
+{
+  /* The position of the next character to read */
+  const char *pos;
+
+  /* The end of the binary encoding; unused for text */
+  const char *end;
+
+  /* Whether the script is in the binary encoding */
+  cl_bool binary;
+
+  /* Bits decoded from base64url characters but not yet read as bytes */
+  unsigned long bits;
+  unsigned bit_count;
+} cl_script_reader_t;
+
+/* Returns the value of a base64url character, or -1 if it is not one */
+static int cl_base64url_value(char c)
+{
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  else if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  else if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  else if (c == '-')
+    return 62;
+  else if (c == '_')
+    return 63;
+  else
+    return -1;
+}
+
+/* Reads the next byte of a script in the binary encoding */
+static cl_error cl_script_read_byte(cl_script_reader_t *reader,
+  unsigned char *byte)
+{
+  while (reader->bit_count < 8)
+  {
+    int value;
+
+    if (reader->pos >= reader->end)
+      return CL_ERR_PARAMETER_INVALID;
+    value = cl_base64url_value(*reader->pos++);
+    if (value < 0)
+      return CL_ERR_PARAMETER_INVALID;
+    reader->bits = ((reader->bits << 6) | (unsigned long)value) & 0xFFFF;
+    reader->bit_count += 6;
+  }
+  reader->bit_count -= 8;
+  *byte = (unsigned char)(reader->bits >> reader->bit_count);
+
+  return CL_OK;
+}
+
+/**
+ * Reads the next number of a script into a value of the given size, in the
+ * same way as `cl_strto`.
+ */
+static cl_error cl_script_read(cl_script_reader_t *reader, void *value,
+  unsigned size, cl_bool is_signed)
+{
+  cl_uint64 number = 0;
+  unsigned shift;
+  unsigned char byte;
+
+  if (!reader->binary)
+    return cl_strto(&reader->pos, value, size, is_signed);
 
-  if (cl_strto(pos, &page->action_count, sizeof(page->action_count), CL_FALSE) != CL_OK)
+  /* Numbers are LEB128 varints, zigzag-encoded if they can be negative */
+  for (shift = 0; ; shift += 7)
+  {
+    if (shift >= 64 || cl_script_read_byte(reader, &byte) != CL_OK)
+      return CL_ERR_PARAMETER_INVALID;
+    number |= (cl_uint64)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      break;
+  }
+  if (is_signed)
+    number = (number >> 1) ^ (~(number & 1) + 1);
+
+  switch (size)
+  {
+  case 1:
+    *(uint8_t*) value = (uint8_t) number;
+    break;
+  case 2:
+    *(uint16_t*)value = (uint16_t)number;
+    break;
+  case 4:
+    *(uint32_t*)value = (uint32_t)number;
+    break;
+  case 8:
+    *(uint64_t*)value = (uint64_t)number;
+    break;
+  default:
+    return CL_ERR_PARAMETER_INVALID;
+  }
+
+  return CL_OK;
+}
+
+static cl_error cl_init_page(cl_script_t *script, cl_script_reader_t *reader,
+  cl_page_t *page)
+{
+  cl_action_t   *action      = NULL;
+  cl_action_t   *prev_action = NULL;
+  unsigned char *fates;
+  cl_error       error;
+  unsigned       i, j;
+
+  if (cl_script_read(reader, &page->action_count, sizeof(page->action_count), CL_FALSE) != CL_OK)
     return CL_ERR_PARAMETER_INVALID;
   page->actions = (cl_action_t*)cl_dma_alloc(page->action_count * sizeof(cl_action_t), CL_TRUE);
   if (!page->actions)
@@ -49,14 +416,14 @@ static cl_error cl_init_page(const char **pos, cl_page_t *page)
   for (i = 0; i < page->action_count; i++)
   {
     action = &page->actions[i];
+    action->script = script;
 
-    if (cl_strto(pos, &action->indentation, sizeof(action->indentation), CL_FALSE) == CL_OK &&
-        cl_strto(pos, &action->type, sizeof(action->type), CL_FALSE) == CL_OK &&
-        cl_strto(pos, &action->argument_count, sizeof(action->argument_count), CL_FALSE) == CL_OK)
+    if (cl_script_read(reader, &action->indentation, sizeof(action->indentation), CL_FALSE) == CL_OK &&
+        cl_script_read(reader, &action->type, sizeof(action->type), CL_FALSE) == CL_OK &&
+        cl_script_read(reader, &action->argument_count, sizeof(action->argument_count), CL_FALSE) == CL_OK)
       cl_log("%u %u %u", page->actions[i].indentation, page->actions[i].type, page->actions[i].argument_count);
-
-    if (cl_init_action(action) != CL_OK)
-      return CL_ERR_CLIENT_RUNTIME;
+    else
+      return CL_ERR_PARAMETER_INVALID;
 
     /* Allocate and initialize action arguments */
     action->arguments = (cl_arg_t*)cl_dma_alloc(action->argument_count * sizeof(cl_arg_t), CL_TRUE);
@@ -64,11 +431,16 @@ static cl_error cl_init_page(const char **pos, cl_page_t *page)
       return CL_ERR_PARAMETER_NULL;
     for (j = 0; j < action->argument_count; j++)
     {
-      if (cl_strto(pos, &action->arguments[j], sizeof(cl_arg_t), CL_TRUE) != CL_OK)
+      if (cl_script_read(reader, &action->arguments[j], sizeof(cl_arg_t), CL_TRUE) != CL_OK)
         return CL_ERR_PARAMETER_INVALID;
       cl_log(" %lld", page->actions[i].arguments[j].uintval);
     }
 
+    if (cl_init_action(action) != CL_OK)
+      return CL_ERR_CLIENT_RUNTIME;
+    else if (cl_action_counter_count(action) > page->counter_count)
+      page->counter_count = cl_action_counter_count(action);
+
     /* Double-linked list */
     action->prev_action = prev_action;
     action->next_action = NULL;
@@ -77,140 +449,362 @@ static cl_error cl_init_page(const char **pos, cl_page_t *page)
 
     cl_log("\n");
   }
-  /* Zero-init the page's counters */
-  for (i = 0; i < CL_COUNTERS_SIZE; i++)
+  fates = (unsigned char*)cl_dma_alloc(page->action_count + 1, CL_FALSE);
+  if (!fates)
+    return CL_ERR_PARAMETER_NULL;
+  cl_page_analyze(page, (unsigned)(page - script->pages), fates);
+  error = cl_page_compile(page, fates);
+  cl_dma_free(fates);
+  if (error != CL_OK || cl_page_find_inputs(page) != CL_OK)
+    return CL_ERR_CLIENT_RUNTIME;
+
+  cl_log("End of page.\n");
+
+  return CL_OK;
+}
+
+/**
+ * Allocates the counters of every page in one arena, once the number each
+ * page needs is known, and zero-initializes them.
+ */
+static cl_error cl_script_init_counters(cl_script_t *script)
+{
+  unsigned largest = 0;
+  unsigned i;
+
+  script->counter_count = 0;
+  for (i = 0; i < script->page_count; i++)
   {
-    page->counters[i].type = CL_MEMTYPE_INT64;
-    cl_ctr_store_int(&page->counters[i], 0);
+    script->counter_count += script->pages[i].counter_count;
+    if (script->pages[i].counter_count > largest)
+      largest = script->pages[i].counter_count;
   }
+  script->counters = (cl_counter_t*)cl_dma_alloc(
+    (script->counter_count + largest + 1) * sizeof(cl_counter_t), CL_TRUE);
+  if (!script->counters)
+    return CL_ERR_PARAMETER_NULL;
 
-  cl_log("End of page.\n");
+  script->counter_count = 0;
+  for (i = 0; i < script->page_count; i++)
+  {
+    script->pages[i].counters = &script->counters[script->counter_count];
+    script->counter_count += script->pages[i].counter_count;
+  }
+  for (i = 0; i < script->counter_count; i++)
+    cl_ctr_store_int(&script->counters[i], 0);
 
   return CL_OK;
 }
 
-cl_error cl_script_init(const char **pos)
+static cl_error cl_script_load(cl_script_t *script,
+  cl_script_reader_t *reader)
 {
   cl_error error;
   unsigned i;
 
-  script.status = CL_SCRIPT_STATUS_INACTIVE;
+  script->status = CL_SCRIPT_STATUS_INACTIVE;
+  memset(&script->writes, 0, sizeof(script->writes));
 
-  if (cl_strto(pos, &script.page_count, sizeof(script.page_count), CL_FALSE) != CL_OK)
+  if (cl_script_read(reader, &script->page_count, sizeof(script->page_count), CL_FALSE) != CL_OK)
     return CL_ERR_PARAMETER_INVALID;
 
-  script.pages = (cl_page_t*)cl_dma_alloc(script.page_count * sizeof(cl_page_t), CL_TRUE);
-  if (!script.pages)
+  script->pages = (cl_page_t*)cl_dma_alloc(script->page_count * sizeof(cl_page_t), CL_TRUE);
+  if (!script->pages)
     return CL_ERR_PARAMETER_NULL;
 
-  for (i = 0; i < script.page_count; i++)
+  for (i = 0; i < script->page_count; i++)
   {
-    error = cl_init_page(pos, &script.pages[i]);
+    error = cl_init_page(script, reader, &script->pages[i]);
     if (error != CL_OK)
       return error;
   }
-  script.status = CL_SCRIPT_STATUS_ACTIVE;
+
+  /* Actions with missing operands are disabled, not fatal to the script */
+  if (cl_script_init_counters(script) != CL_OK)
+    return CL_ERR_PARAMETER_NULL;
+  cl_script_bind(script);
+
+  /* Counters that are set to the same value every frame are set just once */
+  for (i = 0; i < script->page_count; i++)
+  {
+    unsigned j;
+
+    for (j = 0; j < script->pages[i].setup_count; j++)
+      cl_process_action(script->pages[i].setup[j]);
+  }
+#if CL_HAVE_PROFILER
+  memset(&script->profile, 0, sizeof(script->profile));
+#endif
+  script->status = CL_SCRIPT_STATUS_ACTIVE;
 
   return CL_OK;
 }
 
-static unsigned cl_process_if_statements(cl_page_t *page, unsigned pos)
+cl_error cl_script_init(cl_script_t *script, const char **pos)
+{
+  cl_script_reader_t reader;
+  cl_error error;
+
+  if (!pos || !*pos)
+    return CL_ERR_PARAMETER_NULL;
+  memset(&reader, 0, sizeof(reader));
+  reader.pos = *pos;
+  error = cl_script_load(script, &reader);
+  *pos = reader.pos;
+
+  return error;
+}
+
+cl_error cl_script_init_binary(cl_script_t *script, const char *data,
+  unsigned length)
 {
-  unsigned current_indent = page->actions[pos].indentation;
-  cl_bool evaluation = CL_TRUE;
-  unsigned i = pos;
+  cl_script_reader_t reader;
+  unsigned char version;
 
-  if (!page || !page->actions ||
-      page->action_count == 0 || pos >= page->action_count)
-    return page->action_count;
-  current_indent = page->actions[pos].indentation;
-  while (i < page->action_count)
+  if (!data)
+    return CL_ERR_PARAMETER_NULL;
+  memset(&reader, 0, sizeof(reader));
+  reader.pos = data;
+  reader.end = data + length;
+  reader.binary = CL_TRUE;
+  if (cl_script_read_byte(&reader, &version) != CL_OK)
+    return CL_ERR_PARAMETER_INVALID;
+  else if (version != CL_SCRIPT_BINARY_VERSION)
   {
-    cl_action_t *action = &page->actions[i];
+    cl_log("Unsupported binary script version %u.\n", version);
+    return CL_ERR_PARAMETER_INVALID;
+  }
 
-    if (action->if_type && action->indentation == current_indent)
-    {
-      if (evaluation)
-        evaluation = cl_process_action(action);
-      i++;
-    }
-    else if (action->indentation > current_indent)
-    {
-      if (evaluation)
-        return i;
-      else
-      {
-        do
-        {
-          i++;
-        } while (i < page->action_count &&
-                 page->actions[i].indentation > current_indent);
-        return i;
-      }
-    }
-    else
-      return i;
+  return cl_script_load(script, &reader);
+}
+
+cl_error cl_script_bind(cl_script_t *script)
+{
+  cl_error error = CL_OK;
+  unsigned i, j;
+
+  for (i = 0; i < script->page_count; i++)
+  {
+    cl_page_t *page = &script->pages[i];
+
+    for (j = 0; j < page->action_count; j++)
+      if (cl_action_bind(&page->actions[j], page->counters,
+                         page->counter_count) != CL_OK)
+        error = CL_ERR_PARAMETER_INVALID;
+    page->dirty = CL_TRUE;
   }
 
-  return i;
+  return error;
 }
 
-static cl_error cl_process_actions(cl_page_t *page)
+static cl_error cl_process_actions(cl_script_t *script, cl_page_t *page)
 {
   cl_error error = CL_OK;
   unsigned i = 0;
 
-  if (!page || !page->actions || page->action_count == 0)
+  if (!page || !page->steps)
     return CL_ERR_PARAMETER_NULL;
 
-  while (i < page->action_count)
+  while (i < page->step_count && script->status == CL_SCRIPT_STATUS_ACTIVE)
   {
-    script.current_action = &page->actions[i];
+    const cl_step_t *step = &page->steps[i];
+    cl_error result;
+    unsigned next;
+#if CL_HAVE_PROFILER
+    cl_uint64 start = cl_profile_ticks();
+#endif
 
-    if (script.status != CL_SCRIPT_STATUS_ACTIVE)
-      break;
-    else if (page->actions[i].if_type)
-      i = cl_process_if_statements(page, i);
-    else
+    script->current_action = step->action;
+    if (step->fused && step->fused(step->action, &result))
     {
-      if (cl_process_action(&page->actions[i]) != CL_OK)
+      /* The whole chain and its block were run */
+      if (result != CL_OK)
         error = CL_ERR_CLIENT_RUNTIME;
-      i++;
+      next = step->skip;
+    }
+    else
+    {
+      result = cl_process_action(step->action);
+
+      /* Conditions pass by returning a nonzero result */
+      if (step->action->if_type)
+        next = result != CL_OK ? i + 1 : step->skip;
+      else
+      {
+        if (result != CL_OK)
+          error = CL_ERR_CLIENT_RUNTIME;
+        next = step->skip;
+      }
     }
+#if CL_HAVE_PROFILER
+    cl_profile_add(&step->action->profile, cl_profile_ticks() - start);
+#endif
+    i = next;
   }
 
   return error;
 }
 
-cl_error cl_script_update(void)
+/* Returns whether any memory note a page reads changed on the last update */
+static cl_bool cl_page_inputs_changed(const cl_page_t *page)
+{
+  unsigned i;
+
+  if (!memory.changed_count || !memory.changed)
+    return CL_FALSE;
+  for (i = 0; i < page->inputs_size; i++)
+    if (page->inputs[i] & memory.changed[i])
+      return CL_TRUE;
+
+  return CL_FALSE;
+}
+
+cl_error cl_script_update(cl_script_t *script)
 {
+  cl_counter_t *counters;
   cl_error error = CL_OK;
   cl_error page_error;
   unsigned i;
+#if CL_HAVE_PROFILER
+  cl_uint64 start = cl_profile_ticks();
+  cl_uint64 page_start;
+#endif
 
-  if (script.status != CL_SCRIPT_STATUS_ACTIVE)
+  if (script->status != CL_SCRIPT_STATUS_ACTIVE)
     return CL_ERR_CLIENT_RUNTIME;
 
-  for (i = 0; i < script.page_count; i++)
+  /* The end of the arena holds the counters of a page from before it runs */
+  counters = &script->counters[script->counter_count];
+  for (i = 0; i < script->page_count; i++)
   {
-    script.current_page = &script.pages[i];
-    page_error = cl_process_actions(script.current_page);
+    cl_page_t *page = &script->pages[i];
+    cl_bool changed = cl_page_inputs_changed(page);
+
+#if !CL_HAVE_EDITOR
+    /**
+     * With the same inputs and counters, the page would do exactly what it
+     * did last frame. The editor still runs it to keep its state live.
+     */
+    if (!changed && !page->dirty && !page->always_run)
+      continue;
+#endif
+    memcpy(counters, page->counters,
+      page->counter_count * sizeof(cl_counter_t));
+    script->current_page = page;
+#if CL_HAVE_PROFILER
+    page_start = cl_profile_ticks();
+#endif
+    page_error = cl_process_actions(script, page);
+#if CL_HAVE_PROFILER
+    cl_profile_add(&page->profile, cl_profile_ticks() - page_start);
+#endif
     if (page_error != CL_OK)
       error = page_error;
+
+    /**
+     * A note change also moves its previous value on the next update, so
+     * the page runs once more to see that.
+     */
+    page->dirty = changed || memcmp(counters, page->counters,
+      page->counter_count * sizeof(cl_counter_t)) != 0;
   }
 
+  /* Writes made by the script are applied together once it has run */
+  if (cl_memory_flush_writes(&script->writes) != CL_OK)
+    error = CL_ERR_CLIENT_RUNTIME;
+#if CL_HAVE_PROFILER
+  cl_profile_add(&script->profile, cl_profile_ticks() - start);
+#endif
+
   return error;
 }
 
-void cl_script_break(cl_bool fatal, const char *format, ...)
+#if CL_HAVE_PROFILER
+static int cl_profile_entry_compare(const void *a, const void *b)
+{
+  const cl_profile_entry_t *ea = (const cl_profile_entry_t*)a;
+  const cl_profile_entry_t *eb = (const cl_profile_entry_t*)b;
+
+  if (ea->profile.total != eb->profile.total)
+    return ea->profile.total > eb->profile.total ? -1 : 1;
+  else if (ea->page != eb->page)
+    return ea->page < eb->page ? -1 : 1;
+  else if (ea->action != eb->action)
+    return ea->action < eb->action ? -1 : 1;
+  else
+    return 0;
+}
+
+unsigned cl_script_profile(const cl_script_t *script,
+  cl_profile_entry_t *entries, unsigned max)
+{
+  cl_profile_entry_t *table;
+  unsigned count = 0;
+  unsigned i, j;
+
+  for (i = 0; i < script->page_count; i++)
+    count += script->pages[i].action_count + 1;
+  if (!entries)
+    return count;
+  else if (count == 0)
+    return 0;
+
+  table = (cl_profile_entry_t*)cl_dma_alloc(
+    count * sizeof(cl_profile_entry_t), CL_FALSE);
+  if (!table)
+    return 0;
+  count = 0;
+  for (i = 0; i < script->page_count; i++)
+  {
+    const cl_page_t *page = &script->pages[i];
+
+    table[count].page = i;
+    table[count].action = CL_PROFILE_PAGE;
+    table[count].type = CL_ACTTYPE_NO_PROCESS;
+    table[count].profile = page->profile;
+    count++;
+    for (j = 0; j < page->action_count; j++)
+    {
+      table[count].page = i;
+      table[count].action = j;
+      table[count].type = page->actions[j].type;
+      table[count].profile = page->actions[j].profile;
+      count++;
+    }
+  }
+  qsort(table, count, sizeof(cl_profile_entry_t), cl_profile_entry_compare);
+  if (count > max)
+    count = max;
+  memcpy(entries, table, count * sizeof(cl_profile_entry_t));
+  cl_dma_free(table);
+
+  return count;
+}
+
+void cl_script_profile_reset(cl_script_t *script)
+{
+  unsigned i, j;
+
+  memset(&script->profile, 0, sizeof(script->profile));
+  for (i = 0; i < script->page_count; i++)
+  {
+    memset(&script->pages[i].profile, 0, sizeof(cl_profile_t));
+    for (j = 0; j < script->pages[i].action_count; j++)
+      memset(&script->pages[i].actions[j].profile, 0, sizeof(cl_profile_t));
+  }
+}
+#endif
+
+void cl_script_break(cl_script_t *script, cl_bool fatal,
+  const char *format, ...)
 {
   va_list args;
 
-  script.status = CL_SCRIPT_STATUS_PAUSED;
-  script.error_fatal = fatal;
+  script->status = CL_SCRIPT_STATUS_PAUSED;
+  script->error_fatal = fatal;
 
   va_start(args, format);
-  vsnprintf(script.error_msg, sizeof(script.error_msg), format, args);
+  vsnprintf(script->error_msg, sizeof(script->error_msg), format, args);
   va_end(args);
 
   /*
@@ -222,6 +816,6 @@ void cl_script_break(cl_bool fatal, const char *format, ...)
 #if CL_HAVE_EDITOR
     cl_abi_set_pause(1);
 #endif
-    cl_message(CL_MSG_ERROR, script.error_msg);
+    cl_message(CL_MSG_ERROR, script->error_msg);
   }
 }
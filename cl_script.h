@@ -3,6 +3,7 @@
 
 #include "cl_action.h"
 #include "cl_counter.h"
+#include "cl_memory.h"
 
 typedef enum
 {
@@ -14,16 +15,77 @@ typedef enum
   CL_SCRIPT_STATUS_SIZE
 } cl_script_status;
 
-/* TODO: Arbitrary! Have pages allocate more/less depending on need */
-#define CL_COUNTERS_SIZE 16
+/**
+ * One step of a compiled script page. Pages are compiled when loaded so the
+ * nesting of conditions does not need to be worked out from the indentation
+ * of actions every frame.
+ */
+typedef struct
+{
+  /* The action this step runs */
+  cl_action_t *action;
+
+  /**
+   * The step to continue from if this step is a condition that fails. This
+   * skips the rest of its chain of conditions and any block nested under
+   * them. For other steps, this is the next step.
+   */
+  unsigned skip;
+
+  /**
+   * A handler that runs this step's chain of conditions and the action
+   * nested under it at once, or NULL. See `cl_action_fuse`.
+   */
+  cl_fused_func_t fused;
+} cl_step_t;
 
 typedef struct cl_page_t
 {
   cl_action_t *actions;
   unsigned action_count;
 
-  /* Temporary values (bitflags, counters) we can use for logic */
-  cl_counter_t counters[CL_COUNTERS_SIZE];
+  /**
+   * The compiled steps of the page, run in order each frame. Actions that
+   * can never run, or conditions that always pass, have no step.
+   */
+  cl_step_t *steps;
+  unsigned step_count;
+
+  /**
+   * Actions that always leave the same value in a counter nothing else
+   * modifies, run once when the script is loaded instead of every frame.
+   */
+  cl_action_t **setup;
+  unsigned setup_count;
+
+  /**
+   * Temporary values (bitflags, counters) we can use for logic. Points into
+   * the script's counter arena, sized to the highest index the page uses.
+   */
+  cl_counter_t *counters;
+  unsigned counter_count;
+
+  /**
+   * The memory notes the page reads, as a bitset of note indices, and its
+   * size in bytes. A page is only run on frames where one of these notes has
+   * changed, unless `always_run` or `dirty` is set.
+   */
+  unsigned char *inputs;
+  unsigned inputs_size;
+
+  /* Whether the page has actions that must run every frame */
+  cl_bool always_run;
+
+  /**
+   * Whether the page must run next frame regardless of its inputs, because
+   * its last run changed its counters or saw a note change.
+   */
+  cl_bool dirty;
+
+#if CL_HAVE_PROFILER
+  /* Time spent running the page, not counting frames it was skipped */
+  cl_profile_t profile;
+#endif
 
   unsigned flags;
 } cl_page_t;
@@ -33,6 +95,13 @@ typedef struct cl_script_t
   cl_page_t *pages;
   unsigned   page_count;
 
+  /**
+   * The counters of every page, one page after another, followed by space
+   * to copy the counters of the largest page into.
+   */
+  cl_counter_t *counters;
+  unsigned      counter_count;
+
   /* Which action in a script is currently being processed. */
   cl_action_t *current_action;
 
@@ -49,35 +118,122 @@ typedef struct cl_script_t
 
   /* A message describing the cause of the last script break. */
   char error_msg[256];
+
+  /* Memory note writes made this update, applied once the script has run */
+  cl_memory_write_queue_t writes;
+
+#if CL_HAVE_PROFILER
+  /* Time spent in cl_script_update, including applying memory writes */
+  cl_profile_t profile;
+#endif
 } cl_script_t;
 
 /**
- * Frees the current script and all associated values.
+ * Frees a script and all associated values.
+ * @param script The script to free.
  **/
-void cl_script_free(void);
+void cl_script_free(cl_script_t *script);
 
 /**
  * Initializes a script from a string representation of one.
+ * Each script keeps its own pages, counters, status and queue of memory
+ * writes, so several can be loaded at once and updated independently, even
+ * from different threads. They still share the memory notes, so none may be
+ * updated while cl_update_memory is running, and scripts updated at the same
+ * time must not write to the same memory notes.
+ * @param script The script to initialize.
  * @param pos A string iterator positioned at the start of script data.
  * @return CL_OK on success, or an error code on failure.
  **/
-cl_error cl_script_init(const char **pos);
+cl_error cl_script_init(cl_script_t *script, const char **pos);
+
+/**
+ * The version of the binary script encoding this implementation reads. It is
+ * sent to the server when starting a session, so the server only sends a
+ * binary script it knows can be read.
+ */
+#define CL_SCRIPT_BINARY_VERSION 1
+
+/**
+ * Initializes a script from its binary encoding. The encoding holds the same
+ * numbers as the text representation, in the same order, but each is an
+ * LEB128 varint, and action arguments are zigzag-encoded first. It starts
+ * with a single byte holding `CL_SCRIPT_BINARY_VERSION`.
+ * The bytes are passed as unpadded base64url text, so they can be carried in
+ * a JSON string without escapes, and are decoded as they are read.
+ * @param script The script to initialize.
+ * @param data The base64url text, which need not be null-terminated.
+ * @param length The number of characters of text.
+ * @return CL_OK on success, or an error code on failure.
+ **/
+cl_error cl_script_init_binary(cl_script_t *script, const char *data,
+  unsigned length);
+
+/**
+ * Resolves the operands of every action in the script again. Call after
+ *   memory notes are added, as the values actions read may have moved.
+ * @param script The script to bind.
+ * @return CL_OK on success, or an error code if any action was disabled.
+ **/
+cl_error cl_script_bind(cl_script_t *script);
 
 /**
  * Processes all of the actions in a script. Call once per frame, after
  *   cl_memory_update.
+ * @param script The script to process.
  * @return CL_OK on success, or an error code on failure.
  **/
-cl_error cl_script_update(void);
+cl_error cl_script_update(cl_script_t *script);
+
+#if CL_HAVE_PROFILER
+/* The action index of profile entries that describe a whole page */
+#define CL_PROFILE_PAGE ((unsigned)-1)
+
+typedef struct
+{
+  /* The index of the page */
+  unsigned page;
+
+  /* The index of the action in its page, or CL_PROFILE_PAGE */
+  unsigned action;
+
+  /* The type of the action, or CL_ACTTYPE_NO_PROCESS for a page */
+  cl_action_id type;
+
+  cl_profile_t profile;
+} cl_profile_entry_t;
+
+/**
+ * Copies the timing statistics of every page and action in the script into
+ *   a table, ordered from the most total time spent to the least.
+ * @param script The script to read statistics from.
+ * @param entries An array to copy entries into, or NULL to only count them.
+ * @param max The number of entries the array can hold.
+ * @return The number of entries copied, or the number available if
+ *   `entries` is NULL.
+ **/
+unsigned cl_script_profile(const cl_script_t *script,
+  cl_profile_entry_t *entries, unsigned max);
+
+/**
+ * Clears the timing statistics of the script and all of its pages and
+ *   actions.
+ * @param script The script to clear statistics of.
+ **/
+void cl_script_profile_reset(cl_script_t *script);
+#endif
 
 /**
  * Signals to halt processing of the script and core. Used when debugging
  * scripts.
+ * @param script The script to halt.
  * @param fatal Whether or not the break reason included a fatal error.
  * @param format A format string with arguments, to set a reason for breaking.
  **/
-void cl_script_break(cl_bool fatal, const char *format, ...);
+void cl_script_break(cl_script_t *script, cl_bool fatal,
+  const char *format, ...);
 
+/* The script of the current session */
 extern cl_script_t script;
 
 #endif
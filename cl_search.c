@@ -2,127 +2,378 @@
 
 #include "cl_abi.h"
 #include "cl_common.h"
+#include "cl_dma.h"
 #include "cl_memory.h"
 
-#include <math.h>
-#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static cl_error compare_to_nothing(cl_addr_t previous, cl_addr_t current, cl_compare_type type)
+/**
+ * Pointer chains are stored as a sequence of LEB128-style variable-length
+ * integers. The initial address is stored as a zigzag-encoded difference from
+ * the previous chain in the block, as results are found in address order.
+ */
+static unsigned char *cl_ps_put_varint(unsigned char *dst, cl_addr_t value)
 {
-  switch (type)
+  while (value >= 0x80)
   {
-  case CL_COMPARE_EQUAL:
-    return (previous == current) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_LESS:
-  case CL_COMPARE_DECREASED:
-    return (previous > current) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_GREATER:
-  case CL_COMPARE_INCREASED:
-    return (previous < current) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_NOT_EQUAL:
-    return (previous != current) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
+    *dst++ = (unsigned char)(value | 0x80);
+    value >>= 7;
   }
+  *dst++ = (unsigned char)value;
 
-  return CL_ERR_PARAMETER_INVALID;
+  return dst;
+}
+
+static const unsigned char *cl_ps_get_varint(const unsigned char *src,
+  cl_addr_t *value)
+{
+  cl_addr_t result = 0;
+  unsigned shift = 0;
+
+  while (*src & 0x80)
+  {
+    if (shift < sizeof(cl_addr_t) * 8)
+      result |= (cl_addr_t)(*src & 0x7F) << shift;
+    src++;
+    shift += 7;
+  }
+  if (shift < sizeof(cl_addr_t) * 8)
+    result |= (cl_addr_t)*src << shift;
+  *value = result;
+  src++;
+
+  return src;
 }
 
-static cl_error compare_to_nothing_float(cl_addr_t previous, cl_addr_t current, cl_compare_type type)
+/* The largest possible encoding of one chain */
+#define CL_PS_CHAIN_MAX ((sizeof(cl_addr_t) * 8 / 7 + 1) * \
+  (CL_POINTER_MAX_PASSES + 1))
+
+/* Returns a pointer to the value at `index` in an array of values */
+#define CL_PS_VALUE(values, index, size) \
+  ((void*)((unsigned char*)(values) + (index) * (size)))
+
+typedef struct
 {
-  float fprevious, fcurrent;
+  cl_pointersearch_block_t *first;
+  cl_pointersearch_block_t *last;
+  unsigned block_count;
+  cl_addr_t count;
+  cl_addr_t max_count;
+  cl_addr_t memory_usage;
+  unsigned chains_capacity;
+  unsigned value_size;
+  cl_addr_t last_address;
+  FILE *spill;
+  long spill_end;
+} cl_ps_writer_t;
 
-  /* Cast to float */
-  memcpy(&fprevious, &previous, sizeof(float));
-  memcpy(&fcurrent,  &current,  sizeof(float));
+static void cl_ps_writer_init(cl_ps_writer_t *writer, unsigned value_size,
+  cl_addr_t max_count)
+{
+  memset(writer, 0, sizeof(*writer));
+  writer->value_size = value_size;
+  writer->max_count = max_count;
+}
 
-  switch (type)
+static cl_addr_t cl_ps_block_data_size(const cl_pointersearch_block_t *block,
+  unsigned value_size)
+{
+  return block->chains_size +
+    block->count * (sizeof(cl_addr_t) + 2 * value_size);
+}
+
+static void cl_ps_block_free_data(cl_pointersearch_block_t *block)
+{
+  if (!block->mapped)
   {
-  case CL_COMPARE_EQUAL:
-    return ((uint32_t)fprevious == (uint32_t)fcurrent) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_LESS:
-  case CL_COMPARE_DECREASED:
-    return ((uint32_t)fprevious > (uint32_t)fcurrent) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_GREATER:
-  case CL_COMPARE_INCREASED:
-    return ((uint32_t)fprevious < (uint32_t)fcurrent) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_NOT_EQUAL:
-    return ((uint32_t)fprevious != (uint32_t)fcurrent) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
+    free(block->chains);
+    block->chains = NULL;
   }
+  free(block->addresses);
+  free(block->values_current);
+  free(block->values_previous);
+  block->addresses = NULL;
+  block->values_current = NULL;
+  block->values_previous = NULL;
+}
 
-  return CL_ERR_PARAMETER_INVALID;
+/* Shrinks a full block and moves it to the spill file if over budget */
+static void cl_ps_writer_seal(cl_ps_writer_t *writer)
+{
+  cl_pointersearch_block_t *block = writer->last;
+  unsigned value_size = writer->value_size;
+  void *p;
+
+  if (!block || block->spilled || !block->count)
+    return;
+
+  if ((p = realloc(block->chains, block->chains_size)) != NULL)
+    block->chains = (unsigned char*)p;
+  if ((p = realloc(block->addresses, block->count * sizeof(cl_addr_t))) != NULL)
+    block->addresses = (cl_addr_t*)p;
+  if ((p = realloc(block->values_current, block->count * value_size)) != NULL)
+    block->values_current = p;
+  if ((p = realloc(block->values_previous, block->count * value_size)) != NULL)
+    block->values_previous = p;
+  writer->memory_usage += sizeof(*block) +
+    cl_ps_block_data_size(block, value_size);
+
+  if (CL_POINTERSEARCH_SPILL_SIZE &&
+      writer->memory_usage > (cl_addr_t)CL_POINTERSEARCH_SPILL_SIZE)
+  {
+    if (!writer->spill)
+      writer->spill = tmpfile();
+    if (writer->spill &&
+        fseek(writer->spill, writer->spill_end, SEEK_SET) == 0 &&
+        fwrite(block->chains, 1, block->chains_size, writer->spill) ==
+          block->chains_size &&
+        fwrite(block->addresses, sizeof(cl_addr_t), block->count,
+          writer->spill) == block->count &&
+        fwrite(block->values_current, value_size, block->count,
+          writer->spill) == block->count &&
+        fwrite(block->values_previous, value_size, block->count,
+          writer->spill) == block->count)
+    {
+      block->spill_offset = writer->spill_end;
+      block->spilled = CL_TRUE;
+      writer->spill_end += (long)cl_ps_block_data_size(block, value_size);
+      writer->memory_usage -= cl_ps_block_data_size(block, value_size);
+      cl_ps_block_free_data(block);
+    }
+  }
 }
 
-static cl_error compare_to_value(cl_addr_t previous, cl_addr_t current, cl_compare_type type, cl_addr_t value)
+static cl_error cl_ps_writer_push(cl_ps_writer_t *writer, cl_addr_t address,
+  const cl_addr_t *offsets, unsigned passes, cl_addr_t address_final,
+  const void *value_current, const void *value_previous)
 {
-  switch (type)
+  cl_pointersearch_block_t *block = writer->last;
+  unsigned value_size = writer->value_size;
+  unsigned char *dst;
+  cl_addr_t delta;
+  unsigned i;
+
+  if (writer->max_count && writer->count >= writer->max_count)
+    return CL_ERR_CLIENT_RUNTIME;
+
+  /* Start a new block */
+  if (!block || block->count == CL_POINTERSEARCH_BLOCK_SIZE)
   {
-  case CL_COMPARE_EQUAL:
-    return (current == value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_GREATER:
-    return (current > value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_LESS:
-    return (current < value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_NOT_EQUAL:
-    return (current != value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_INCREASED:
-    return (current == previous + value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_DECREASED:
-    return (current + value == previous) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
+    cl_ps_writer_seal(writer);
+    block = (cl_pointersearch_block_t*)calloc(1, sizeof(*block));
+    if (!block)
+      return CL_ERR_CLIENT_RUNTIME;
+    writer->chains_capacity = CL_POINTERSEARCH_BLOCK_SIZE * 4;
+    block->chains = (unsigned char*)malloc(writer->chains_capacity);
+    block->addresses = (cl_addr_t*)malloc(
+      CL_POINTERSEARCH_BLOCK_SIZE * sizeof(cl_addr_t));
+    block->values_current = malloc(CL_POINTERSEARCH_BLOCK_SIZE * value_size);
+    block->values_previous = malloc(CL_POINTERSEARCH_BLOCK_SIZE * value_size);
+    if (!block->chains || !block->addresses || !block->values_current ||
+        !block->values_previous)
+    {
+      cl_ps_block_free_data(block);
+      free(block);
+      return CL_ERR_CLIENT_RUNTIME;
+    }
+    if (writer->last)
+      writer->last->next = block;
+    else
+      writer->first = block;
+    writer->last = block;
+    writer->last_address = 0;
+    writer->block_count++;
   }
 
-  return CL_ERR_PARAMETER_INVALID;
+  /* Make sure there is room for the largest possible chain */
+  if (block->chains_size + CL_PS_CHAIN_MAX > writer->chains_capacity)
+  {
+    unsigned char *chains = (unsigned char*)realloc(block->chains,
+      writer->chains_capacity * 2);
+
+    if (!chains)
+      return CL_ERR_CLIENT_RUNTIME;
+    block->chains = chains;
+    writer->chains_capacity *= 2;
+  }
+
+  /* Zigzag the difference so chains found out of order stay small */
+  delta = address - writer->last_address;
+  delta = (delta << 1) ^ ((delta >> (sizeof(cl_addr_t) * 8 - 1)) ?
+    ~(cl_addr_t)0 : 0);
+  dst = cl_ps_put_varint(&block->chains[block->chains_size], delta);
+  for (i = 0; i < passes; i++)
+    dst = cl_ps_put_varint(dst, offsets[i]);
+  block->chains_size = (unsigned)(dst - block->chains);
+  block->addresses[block->count] = address_final;
+  memcpy(CL_PS_VALUE(block->values_current, block->count, value_size),
+    value_current, value_size);
+  memcpy(CL_PS_VALUE(block->values_previous, block->count, value_size),
+    value_previous, value_size);
+  block->count++;
+  writer->last_address = address;
+  writer->count++;
+
+  return CL_OK;
 }
 
-static cl_error compare_to_value_float(cl_addr_t previous, cl_addr_t current, cl_compare_type type,
-  float value)
+static void cl_ps_free_blocks(cl_pointersearch_t *search)
 {
-  float fprevious, fcurrent;
-  cl_bool has_decimal_precision;
+  cl_pointersearch_block_t *block = search->first_block;
 
-  /* Cast to float */
-  memcpy(&fprevious, &previous, sizeof(float));
-  memcpy(&fcurrent,  &current,  sizeof(float));
+  while (block)
+  {
+    cl_pointersearch_block_t *next = block->next;
 
-  /* This float is NaN */
-  if (isnan(fcurrent))
-    return CL_ERR_PARAMETER_INVALID;
+    cl_ps_block_free_data(block);
+    free(block);
+    block = next;
+  }
+  if (search->spill)
+    fclose((FILE*)search->spill);
+  cl_ps_block_free_data(&search->spill_data);
+#if CL_HAVE_FILESYSTEM
+  cl_dma_unmap_file(search->file_data, search->file_size);
+  search->file_data = NULL;
+  search->file_size = 0;
+#endif
+  search->first_block = NULL;
+  search->block_count = 0;
+  search->result_count = 0;
+  search->memory_usage = 0;
+  search->spill = NULL;
+  search->spill_loaded = NULL;
+  search->cursor_block = NULL;
+}
 
-  /* Only check decimal precision on equal ops if the user has specified */
-  has_decimal_precision = floor(value) != value;
+/* Frees the results of a writer that could not be finished */
+static void cl_ps_writer_discard(cl_ps_writer_t *writer)
+{
+  cl_pointersearch_block_t *block = writer->first;
 
-  switch (type)
+  while (block)
   {
-  case CL_COMPARE_EQUAL:
-    if (has_decimal_precision)
-      return (fcurrent == value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-    else
-      return (floor(fcurrent) == value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_GREATER:
-    return (fcurrent > value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_LESS:
-    return (fcurrent < value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_NOT_EQUAL:
-    return (fcurrent != value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_INCREASED:
-    if (has_decimal_precision)
-      return (fcurrent == fprevious + value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-    else
-      return (floor(fcurrent) == floor(fprevious) + value) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-  case CL_COMPARE_DECREASED:
-    if (has_decimal_precision)
-      return (fcurrent + value == fprevious) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
-    else
-      return (floor(fcurrent) + value == floor(fprevious)) ? CL_OK : CL_ERR_CLIENT_RUNTIME;
+    cl_pointersearch_block_t *next = block->next;
+
+    cl_ps_block_free_data(block);
+    free(block);
+    block = next;
   }
+  if (writer->spill)
+    fclose(writer->spill);
+  memset(writer, 0, sizeof(*writer));
+}
 
-  return CL_ERR_PARAMETER_INVALID;
+/* Replaces the results of a search with those of a finished writer */
+static void cl_ps_writer_finish(cl_ps_writer_t *writer,
+  cl_pointersearch_t *search)
+{
+  cl_ps_writer_seal(writer);
+  cl_ps_free_blocks(search);
+  search->first_block = writer->first;
+  search->block_count = writer->block_count;
+  search->result_count = writer->count;
+  search->memory_usage = writer->memory_usage;
+  search->spill = writer->spill;
+}
+
+static cl_error cl_ps_block_validate(cl_pointersearch_t *search,
+  cl_pointersearch_block_t *block);
+
+/**
+ * Returns a block with its arrays available, reading them from the spill
+ * file or resolving them against live memory if needed. Only one spilled
+ * block is loaded at a time.
+ */
+static cl_pointersearch_block_t *cl_ps_block_load(cl_pointersearch_t *search,
+  cl_pointersearch_block_t *block)
+{
+  cl_pointersearch_block_t *data = &search->spill_data;
+  unsigned value_size = search->params.value_size;
+  FILE *spill = (FILE*)search->spill;
+  void *p;
+
+  if (block->pending)
+    return cl_ps_block_validate(search, block) == CL_OK ? block : NULL;
+  else if (!block->spilled)
+    return block;
+  else if (search->spill_loaded == block)
+    return data;
+
+  search->spill_loaded = NULL;
+  if (!data->addresses)
+  {
+    data->addresses = (cl_addr_t*)malloc(
+      CL_POINTERSEARCH_BLOCK_SIZE * sizeof(cl_addr_t));
+    data->values_current = malloc(CL_POINTERSEARCH_BLOCK_SIZE * value_size);
+    data->values_previous = malloc(CL_POINTERSEARCH_BLOCK_SIZE * value_size);
+  }
+  if ((p = realloc(data->chains, block->chains_size ? block->chains_size : 1)) != NULL)
+    data->chains = (unsigned char*)p;
+  if (!p || !data->addresses || !data->values_current ||
+      !data->values_previous || !spill ||
+      fseek(spill, block->spill_offset, SEEK_SET) != 0 ||
+      fread(data->chains, 1, block->chains_size, spill) != block->chains_size ||
+      fread(data->addresses, sizeof(cl_addr_t), block->count, spill) !=
+        block->count ||
+      fread(data->values_current, value_size, block->count, spill) !=
+        block->count ||
+      fread(data->values_previous, value_size, block->count, spill) !=
+        block->count)
+    return NULL;
+  data->chains_size = block->chains_size;
+  data->count = block->count;
+  search->spill_loaded = block;
+
+  return data;
+}
+
+/* Writes the addresses and values of a loaded spilled block back to file */
+static cl_error cl_ps_block_store(cl_pointersearch_t *search,
+  cl_pointersearch_block_t *block)
+{
+  const cl_pointersearch_block_t *data = &search->spill_data;
+  unsigned value_size = search->params.value_size;
+  FILE *spill = (FILE*)search->spill;
+
+  if (!block->spilled)
+    return CL_OK;
+  else if (search->spill_loaded != block ||
+           fseek(spill, block->spill_offset + (long)block->chains_size,
+             SEEK_SET) != 0 ||
+           fwrite(data->addresses, sizeof(cl_addr_t), block->count, spill) !=
+             block->count ||
+           fwrite(data->values_current, value_size, block->count, spill) !=
+             block->count ||
+           fwrite(data->values_previous, value_size, block->count, spill) !=
+             block->count)
+    return CL_ERR_CLIENT_RUNTIME;
+  else
+    return CL_OK;
+}
+
+/* Decodes one chain, returning a pointer past it */
+static const unsigned char *cl_ps_decode_chain(const unsigned char *src,
+  cl_addr_t *address, cl_addr_t *offsets, unsigned passes)
+{
+  cl_addr_t delta;
+  unsigned i;
+
+  src = cl_ps_get_varint(src, &delta);
+  *address += (delta >> 1) ^ ((delta & 1) ? ~(cl_addr_t)0 : 0);
+  for (i = 0; i < passes; i++)
+    src = cl_ps_get_varint(src, &offsets[i]);
+
+  return src;
 }
 
-static cl_error resolve_pointerresult(cl_addr_t *final_address, const cl_pointersearch_result_t *result,
-  const unsigned passes)
+static cl_error resolve_pointerresult(cl_addr_t *final_address,
+  cl_addr_t address, const cl_addr_t *offsets, const unsigned passes)
 {
-  cl_addr_t address = result->address_initial;
+  cl_addr_t pointer;
   unsigned i;
 
   for (i = 0; i < passes; i++)
@@ -134,254 +385,1032 @@ static cl_error resolve_pointerresult(cl_addr_t *final_address, const cl_pointer
       return CL_ERR_PARAMETER_NULL;
 
     ptr_type = cl_pointer_type(region->pointer_length);
-    if (cl_read_memory_value(&address, NULL, address, ptr_type) != CL_OK)
+    pointer = 0;
+    if (cl_read_memory_value(&pointer, NULL, address, ptr_type) != CL_OK)
       return CL_ERR_CLIENT_RUNTIME;
 
-    address += result->offsets[i];
+    address = pointer + offsets[i];
   }
   *final_address = address;
 
   return CL_OK;
 }
 
+/**
+ * Resolves each chain of a block loaded from a scan file against live
+ * memory, filling in its addresses and values.
+ */
+static cl_error cl_ps_block_validate(cl_pointersearch_t *search,
+  cl_pointersearch_block_t *block)
+{
+  cl_addr_t offsets[CL_POINTER_MAX_PASSES];
+  cl_addr_t initial = 0;
+  unsigned value_size = search->params.value_size;
+  unsigned pos = 0;
+  unsigned i;
+
+  block->addresses = (cl_addr_t*)calloc(block->count + 1, sizeof(cl_addr_t));
+  block->values_current = calloc(block->count + 1, value_size);
+  block->values_previous = calloc(block->count + 1, value_size);
+  if (!block->addresses || !block->values_current || !block->values_previous)
+  {
+    cl_ps_block_free_data(block);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+
+  for (i = 0; i < block->count; i++)
+  {
+    void *current = CL_PS_VALUE(block->values_current, i, value_size);
+
+    pos = (unsigned)(cl_ps_decode_chain(&block->chains[pos], &initial,
+      offsets, search->passes) - block->chains);
+
+    /* Chains that no longer resolve are left zeroed for the next step */
+    if (resolve_pointerresult(&block->addresses[i], initial, offsets,
+          search->passes) == CL_OK)
+      cl_read_memory_value(current, NULL, block->addresses[i],
+        search->params.value_type);
+  }
+  memcpy(block->values_previous, block->values_current,
+    block->count * value_size);
+  block->pending = CL_FALSE;
+  search->memory_usage += cl_ps_block_data_size(block, value_size) -
+    block->chains_size;
+
+  return CL_OK;
+}
+
 cl_error cl_pointersearch_free(cl_pointersearch_t *search)
 {
   if (!search)
     return CL_ERR_PARAMETER_NULL;
   else
   {
-    free(search->results);
+    cl_ps_free_blocks(search);
     return CL_OK;
   }
 }
 
-static cl_error add_pass(cl_pointersearch_t* search)
+cl_error cl_pointersearch_get_result(cl_pointersearch_t *search,
+  cl_addr_t index, cl_pointersearch_result_t *result)
 {
-  cl_memory_region_t *region;
-  cl_pointersearch_result_t *result;
-  cl_addr_t matches, target, value;
-  unsigned i, j, k, l;
+  cl_pointersearch_block_t *data;
+  cl_addr_t offsets[CL_POINTER_MAX_PASSES];
+  unsigned value_size, i;
 
-  cl_pointersearch_result_t* new_results = (cl_pointersearch_result_t*)calloc(
-    search->max_results, sizeof(cl_pointersearch_result_t));
-  matches = 0;
-  search->passes += 1;
+  if (!search || !result)
+    return CL_ERR_PARAMETER_NULL;
+  else if (index >= search->result_count)
+    return CL_ERR_PARAMETER_INVALID;
 
-  for (i = 0; i < search->result_count; i++)
+  /* Restart from the start of the block if the result was already passed */
+  if (search->cursor_block && index < search->cursor_index &&
+      index >= search->cursor_block_first)
+  {
+    search->cursor_index = search->cursor_block_first;
+    search->cursor_address = 0;
+    search->cursor_pos = 0;
+  }
+  /* Restart from the beginning if we can't continue from the cursor */
+  else if (!search->cursor_block || index < search->cursor_index)
   {
-    cl_pointersearch_result_t *next_result = &search->results[i];
+    search->cursor_block = search->first_block;
+    search->cursor_block_first = 0;
+    search->cursor_index = 0;
+    search->cursor_address = 0;
+    search->cursor_pos = 0;
+  }
 
-    for (j = 0; j < memory.region_count; j++)
-    {
-      region = &memory.regions[j];
-      target = next_result->address_initial;
+  /* Skip whole blocks without decoding them */
+  while (index >= search->cursor_block_first + search->cursor_block->count)
+  {
+    search->cursor_block_first += search->cursor_block->count;
+    search->cursor_block = search->cursor_block->next;
+    search->cursor_index = search->cursor_block_first;
+    search->cursor_address = 0;
+    search->cursor_pos = 0;
+  }
 
-      if (region->size < region->pointer_length)
-        continue;
+  data = cl_ps_block_load(search, search->cursor_block);
+  if (!data)
+    return CL_ERR_CLIENT_RUNTIME;
+  else if (index >= search->cursor_block_first + data->count)
+    return CL_ERR_PARAMETER_INVALID;
 
-      for (k = 0; k < region->size; k += region->pointer_length)
-      {
-        cl_value_type ptr_type = cl_pointer_type(region->pointer_length);
-        cl_read_memory_value_internal(&value, region, k, ptr_type);
+  memset(result, 0, sizeof(*result));
+  while (search->cursor_index <= index)
+  {
+    search->cursor_pos = (unsigned)(cl_ps_decode_chain(
+      &data->chains[search->cursor_pos], &search->cursor_address, offsets,
+      search->passes) - data->chains);
+    search->cursor_index++;
+  }
+  i = (unsigned)(index - search->cursor_block_first);
+  value_size = search->params.value_size;
+  result->address_initial = search->cursor_address;
+  memcpy(result->offsets, offsets, search->passes * sizeof(cl_addr_t));
+  result->address_final = data->addresses[i];
+  cl_ctr_store(&result->value_current,
+    CL_PS_VALUE(data->values_current, i, value_size),
+    search->params.value_type);
+  cl_ctr_store(&result->value_previous,
+    CL_PS_VALUE(data->values_previous, i, value_size),
+    search->params.value_type);
 
-        if (value <= target && value >= target - search->range)
-        {
-          result = &new_results[matches];
+  return CL_OK;
+}
 
-          /* Shift all offsets over by one */
-          for (l = search->passes - 1; l > 0; l--)
-            result->offsets[l] = next_result->offsets[l - 1];
+/* A pointer found in memory, and where it was found */
+typedef struct
+{
+  cl_addr_t value;
+  cl_addr_t address;
+} cl_ps_pointer_t;
 
-          /* Make this the new initial offset */
-          result->offsets[0] = target - value;
-          result->address_initial = region->base_guest + k;
-          matches++;
-        }
+/* A range of guest addresses */
+typedef struct
+{
+  cl_addr_t start;
+  cl_addr_t end;
+} cl_ps_range_t;
+
+/**
+ * Every value in a memory snapshot that points into a memory region, sorted
+ * by value so the pointers to a target range can be found with a binary
+ * search instead of scanning all of memory for each target.
+ */
+typedef struct
+{
+  cl_ps_pointer_t *pointers;
+  cl_addr_t count;
+
+  /* The static memory regions, sorted by address */
+  cl_ps_range_t *statics;
+  unsigned static_count;
+} cl_ps_map_t;
+
+/* Which chain roots to add in a pass */
+typedef enum
+{
+  CL_PS_ROOTS_ALL = 0,
+  CL_PS_ROOTS_STATIC,
+  CL_PS_ROOTS_DYNAMIC
+} cl_ps_roots_t;
+
+/**
+ * Whether a region could contain pointers at all. Regions with no flags set
+ * are assumed to be plain memory. Read-only regions are kept, as tables in
+ * an image's read-only data can be static roots.
+ */
+static cl_bool cl_ps_region_can_hold_pointers(const cl_memory_region_t *region)
+{
+  const cl_memory_region_flags flags = region->flags;
+
+  if (!region->pointer_length || region->size < region->pointer_length)
+    return CL_FALSE;
+  else if (!flags.raw)
+    return CL_TRUE;
+  else
+    return flags.bits.read && !flags.bits.free &&
+           !(flags.bits.reserve && !flags.bits.commit);
+}
+
+static cl_bool cl_ps_region_filter(const cl_memory_region_t *region,
+  const void *userdata)
+{
+  const cl_pointersearch_filter_t *filter =
+    (const cl_pointersearch_filter_t*)userdata;
+
+  if (!cl_ps_region_can_hold_pointers(region))
+    return CL_FALSE;
+  else if (!region->flags.raw)
+    return CL_TRUE;
+  else
+    return (region->flags.raw & filter->required.raw) == filter->required.raw &&
+           !(region->flags.raw & filter->excluded.raw);
+}
+
+/**
+ * Whether a region has a fixed address between sessions: either backed by an
+ * executable image, or a writable region directly following one.
+ * @param prev The region before this one in address order, or NULL
+ */
+static cl_bool cl_ps_region_is_static(const cl_memory_region_t *region,
+  const cl_memory_region_t *prev)
+{
+  if (!region->flags.raw || region->flags.bits.image)
+    return CL_TRUE;
+  else if (region->flags.bits.mapped || !region->flags.bits.write)
+    return CL_FALSE;
+  else
+    return prev && prev->flags.bits.image &&
+           prev->base_guest + prev->size == region->base_guest;
+}
+
+static int cl_ps_pointer_compare(const void *a, const void *b)
+{
+  const cl_ps_pointer_t *pa = (const cl_ps_pointer_t*)a;
+  const cl_ps_pointer_t *pb = (const cl_ps_pointer_t*)b;
+
+  if (pa->value != pb->value)
+    return pa->value < pb->value ? -1 : 1;
+  else if (pa->address != pb->address)
+    return pa->address < pb->address ? -1 : 1;
+  else
+    return 0;
+}
+
+static void cl_ps_map_free(cl_ps_map_t *map)
+{
+  free(map->pointers);
+  free(map->statics);
+  map->pointers = NULL;
+  map->statics = NULL;
+  map->count = 0;
+  map->static_count = 0;
+}
+
+static cl_error cl_ps_map_init(cl_ps_map_t *map,
+  const cl_memory_snapshot_t *snapshot)
+{
+  cl_addr_t capacity = 0;
+  cl_addr_t low = ~(cl_addr_t)0;
+  cl_addr_t high = 0;
+  cl_addr_t value;
+  unsigned i;
+
+  map->pointers = NULL;
+  map->count = 0;
+  map->static_count = 0;
+  map->statics = (cl_ps_range_t*)malloc(
+    (memory.region_count + 1) * sizeof(cl_ps_range_t));
+  if (!map->statics)
+    return CL_ERR_CLIENT_RUNTIME;
 
-        /* Back out if we have too many results */
-        if (matches == search->max_results)
+  /**
+   * Anything outside of the span of all regions can't be a pointer. This
+   * includes regions that aren't scanned, as they can still be pointed to.
+   * Regions are sorted, so the region before each one is its neighbour.
+   */
+  for (i = 0; i < memory.region_count; i++)
+  {
+    const cl_memory_region_t *region = &memory.regions[i];
+
+    if (region->base_guest < low)
+      low = region->base_guest;
+    if (region->base_guest + region->size > high)
+      high = region->base_guest + region->size;
+    if (cl_ps_region_is_static(region, i ? &memory.regions[i - 1] : NULL))
+    {
+      map->statics[map->static_count].start = region->base_guest;
+      map->statics[map->static_count].end = region->base_guest + region->size;
+      map->static_count++;
+    }
+  }
+
+  for (i = 0; i < snapshot->region_count; i++)
+  {
+    const cl_memory_region_t *region = &snapshot->regions[i];
+    cl_value_type ptr_type = cl_pointer_type(region->pointer_length);
+    cl_addr_t k;
+
+    for (k = 0; k + region->pointer_length <= region->size;
+         k += region->pointer_length)
+    {
+      value = 0;
+      if (cl_read_memory_value_internal(&value, region, k, ptr_type) != CL_OK ||
+          value < low || value >= high)
+        continue;
+
+      if (map->count == capacity)
+      {
+        cl_ps_pointer_t *pointers;
+
+        capacity = capacity ? capacity * 2 : 1024;
+        pointers = (cl_ps_pointer_t*)realloc(map->pointers,
+          capacity * sizeof(cl_ps_pointer_t));
+        if (!pointers)
         {
-          cl_log("Search reached maximum count of %llu.\n", (unsigned long long)search->max_results);
-          goto end;
+          cl_ps_map_free(map);
+          return CL_ERR_CLIENT_RUNTIME;
         }
+        map->pointers = pointers;
       }
+      map->pointers[map->count].value = value;
+      map->pointers[map->count].address = region->base_guest + k;
+      map->count++;
     }
   }
-  end:
-  free(search->results);
-  search->results = new_results;
-  search->result_count = matches;
+  qsort(map->pointers, map->count, sizeof(cl_ps_pointer_t),
+    cl_ps_pointer_compare);
 
   return CL_OK;
 }
 
-cl_error cl_pointersearch_init(cl_pointersearch_t *search,
-  cl_addr_t address, cl_value_type value_type, unsigned passes, cl_addr_t range,
-  cl_addr_t max_results)
+/* Returns the index of the first pointer with a value of at least `value` */
+static cl_addr_t cl_ps_map_find(const cl_ps_map_t *map, cl_addr_t value)
 {
-  cl_memory_region_t *region;
-  cl_pointersearch_result_t *result;
-  cl_addr_t matches, prev_value, value;
-  unsigned i, j;
+  cl_addr_t low = 0;
+  cl_addr_t high = map->count;
 
-  if (!search || address == 0 || passes == 0)
-    return CL_ERR_PARAMETER_INVALID;
+  while (low < high)
+  {
+    cl_addr_t mid = low + (high - low) / 2;
 
-  /* Is the address we're looking for valid? */
-  if (cl_read_memory_value(&prev_value, NULL, address, value_type) != CL_OK)
+    if (map->pointers[mid].value < value)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low;
+}
+
+/* Whether an address is within one of the static regions of a map */
+static cl_bool cl_ps_map_is_static(const cl_ps_map_t *map, cl_addr_t address)
+{
+  unsigned low = 0;
+  unsigned high = map->static_count;
+
+  while (low < high)
   {
-    cl_log("Address %016llX is invalid for a pointer search.\n", (unsigned long long)address);
-    return CL_ERR_PARAMETER_INVALID;
+    unsigned mid = low + (high - low) / 2;
+
+    if (address < map->statics[mid].start)
+      high = mid;
+    else if (address >= map->statics[mid].end)
+      low = mid + 1;
+    else
+      return CL_TRUE;
   }
 
-    /* Initialize search parameters */
-    search->passes          = 1;
-    search->range          = range;
-    search->max_results    = max_results;
-    search->params.compare_type = CL_COMPARE_EQUAL;
-    search->params.value_size   = cl_sizeof_memtype(value_type);
-    search->params.value_type   = value_type;
+  return CL_FALSE;
+}
 
-    /* We create a temporary array of max size and trim it down after */
-    search->results = (cl_pointersearch_result_t*)calloc(
-      max_results, sizeof(cl_pointersearch_result_t));
-    matches = 0;
+/**
+ * Adds every pointer within `range` bytes before `target` as a result, with
+ * the offset to the target placed before `offsets`.
+ */
+static cl_error cl_ps_map_push(cl_ps_writer_t *writer, const cl_ps_map_t *map,
+  cl_ps_roots_t roots, cl_addr_t target, cl_addr_t range, cl_addr_t *offsets,
+  unsigned passes, cl_addr_t address_final, const void *value_current,
+  const void *value_previous)
+{
+  cl_addr_t i = cl_ps_map_find(map, target >= range ? target - range : 0);
 
-    /* Do a quick scan to see how many results we start with */
-    for (i = 0; i < memory.region_count; i++)
-    {
-      region = &memory.regions[i];
+  for (; i < map->count && map->pointers[i].value <= target; i++)
+  {
+    if (roots != CL_PS_ROOTS_ALL &&
+        cl_ps_map_is_static(map, map->pointers[i].address) !=
+          (roots == CL_PS_ROOTS_STATIC))
+      continue;
+    offsets[0] = target - map->pointers[i].value;
+    if (cl_ps_writer_push(writer, map->pointers[i].address, offsets, passes,
+          address_final, value_current, value_previous) != CL_OK)
+      return CL_ERR_CLIENT_RUNTIME;
+  }
 
-      if (region->size < region->pointer_length)
-        continue;
+  return CL_OK;
+}
 
-#if CL_EXTERNAL_MEMORY
-      region->base_host = malloc(region->size);
-      cl_read_memory_buffer_external(region->base_host, NULL, region->base_guest, region->size);
-#endif
+/* Extends every existing chain by one pointer level */
+static cl_error cl_ps_extend(cl_pointersearch_t *search, const cl_ps_map_t *map,
+  cl_ps_writer_t *writer, cl_ps_roots_t roots)
+{
+  cl_pointersearch_block_t *block;
+  cl_addr_t offsets[CL_POINTER_MAX_PASSES];
+  unsigned value_size = search->params.value_size;
+  unsigned i;
 
-      for (j = 0; j < region->size; j += region->pointer_length)
-      {
-        cl_value_type ptr_type = cl_pointer_type(region->pointer_length);
-        cl_read_memory_value_internal(&value, region, j, ptr_type);
+  for (block = search->first_block; block; block = block->next)
+  {
+    cl_pointersearch_block_t *data = cl_ps_block_load(search, block);
+    cl_addr_t address = 0;
+    unsigned pos = 0;
 
-        if (value <= address && value >= address - range)
-        {
-          result = &search->results[matches];
-
-          result->offsets[0]    = address - value;
-          result->address_initial = region->base_guest + j;
-          result->address_final  = address;
-          result->value_current  = prev_value;
-          result->value_previous  = prev_value;
-          matches++;
-        }
+    if (!data)
+      return CL_ERR_CLIENT_RUNTIME;
 
-        if (matches == max_results)
-        {
-          search->result_count = max_results;
-          cl_log("Pointer search for %016llX reached maximum result count of %llu.\n",
-            (unsigned long long)address, (unsigned long long)max_results);
+    for (i = 0; i < data->count; i++)
+    {
+      /* Decode into the offsets past the first, shifting them over by one */
+      pos = (unsigned)(cl_ps_decode_chain(&data->chains[pos], &address,
+        &offsets[1], search->passes - 1) - data->chains);
 
-          return CL_OK;
-        }
-      }
+      if (cl_ps_map_push(writer, map, roots, address, search->range, offsets,
+            search->passes, data->addresses[i],
+            CL_PS_VALUE(data->values_current, i, value_size),
+            CL_PS_VALUE(data->values_previous, i, value_size)) != CL_OK)
+        return CL_ERR_CLIENT_RUNTIME;
     }
-    search->result_count = matches;
+  }
+
+  return CL_OK;
+}
+
+/**
+ * Adds one pointer level to every result. On the last pass, results with
+ * static roots are placed first, or are the only ones kept if the filter
+ * asks for it.
+ */
+static cl_error add_pass(cl_pointersearch_t* search, const cl_ps_map_t *map,
+  cl_bool last)
+{
+  cl_ps_writer_t writer;
+  cl_error error;
+
+  cl_ps_writer_init(&writer, search->params.value_size, search->max_results);
+  search->passes += 1;
+
+  if (!last)
+    error = cl_ps_extend(search, map, &writer, CL_PS_ROOTS_ALL);
+  else
+  {
+    error = cl_ps_extend(search, map, &writer, CL_PS_ROOTS_STATIC);
+    search->static_count = writer.count;
+    if (error == CL_OK && !search->filter.static_roots_only)
+      error = cl_ps_extend(search, map, &writer, CL_PS_ROOTS_DYNAMIC);
+  }
+
+  /* Back out if we have too many results */
+  if (error != CL_OK)
+    cl_log("Search reached maximum count of " CL_FU64 ".\n",
+      (cl_uint64)writer.count);
+  cl_ps_writer_finish(&writer, search);
+
+  return CL_OK;
+}
+
+cl_error cl_pointersearch_init(cl_pointersearch_t *search,
+  cl_addr_t address, cl_value_type value_type, unsigned passes, cl_addr_t range,
+  cl_addr_t max_results, const cl_pointersearch_filter_t *filter)
+{
+  cl_memory_snapshot_t snapshot;
+  cl_search_target_t value;
+  cl_ps_writer_t writer;
+  cl_ps_map_t map;
+  cl_addr_t offset;
+  cl_error error;
+  unsigned value_size = cl_sizeof_memtype(value_type);
+  unsigned i;
+
+  if (!search || address == 0 || passes == 0 ||
+      passes > CL_POINTER_MAX_PASSES || value_size == 0 ||
+      value_size > sizeof(value))
+    return CL_ERR_PARAMETER_INVALID;
+
+  /* Is the address we're looking for valid? */
+  memset(&value, 0, sizeof(value));
+  if (cl_read_memory_value(value.raw, NULL, address, value_type) != CL_OK)
+  {
+    cl_log("Address " CL_FX64 " is invalid for a pointer search.\n",
+      (cl_uint64)address);
+    return CL_ERR_PARAMETER_INVALID;
+  }
+
+  /* Initialize search parameters */
+  memset(search, 0, sizeof(*search));
+  search->passes          = 1;
+  search->range          = range;
+  search->max_results    = max_results;
+  search->params.compare_type = CL_COMPARE_EQUAL;
+  search->params.value_size   = value_size;
+  search->params.value_type   = value_type;
+  search->params.target_ptr   = &search->params.target;
+  search->params.target_none  = 1;
+  if (filter)
+    search->filter = *filter;
+
+  /**
+   * Read the regions that can hold pointers once and index every pointer in
+   * them. Every pass reads from this instead of the live memory regions.
+   */
+  cl_abi_set_pause(1);
+  if (cl_memory_snapshot_init(&snapshot, cl_ps_region_filter,
+        &search->filter) != CL_OK)
+  {
+    cl_abi_set_pause(0);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else if (cl_ps_map_init(&map, &snapshot) != CL_OK)
+  {
+    cl_memory_snapshot_free(&snapshot);
+    cl_abi_set_pause(0);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_log("Pointer search is scanning %u of %u memory regions.\n",
+    snapshot.region_count, memory.region_count);
+  cl_memory_snapshot_free(&snapshot);
+  cl_abi_set_pause(0);
+
+  /* Results are added to blocks as they are found */
+  cl_ps_writer_init(&writer, value_size, max_results);
+  if (passes > 1)
+    error = cl_ps_map_push(&writer, &map, CL_PS_ROOTS_ALL, address, range,
+      &offset, 1, address, value.raw, value.raw);
+  else
+  {
+    error = cl_ps_map_push(&writer, &map, CL_PS_ROOTS_STATIC, address, range,
+      &offset, 1, address, value.raw, value.raw);
+    search->static_count = writer.count;
+    if (error == CL_OK && !search->filter.static_roots_only)
+      error = cl_ps_map_push(&writer, &map, CL_PS_ROOTS_DYNAMIC, address,
+        range, &offset, 1, address, value.raw, value.raw);
+  }
+  cl_ps_writer_finish(&writer, search);
 
+  if (error != CL_OK)
+    cl_log("Pointer search for " CL_FX64 " reached maximum result count of "
+      CL_FU64 ".\n", (cl_uint64)address, (cl_uint64)search->result_count);
+  else
+  {
     /* We've only done one pass so far. Run any extra passes */
     for (i = passes; i > 1; i--)
-      add_pass(search);
-
-    /* Clear the unneeded memory */
-    search->result_count = matches;
-    search->results = (cl_pointersearch_result_t*)realloc(
-      search->results, matches * sizeof(cl_pointersearch_result_t));
-#if CL_EXTERNAL_MEMORY
-    free(region->base_host);
-    region->base_host = NULL;
-#endif
+      if (add_pass(search, &map, i == 2) != CL_OK)
+        break;
 
-    cl_log("Pointer search for %016llX found %llu results.\n",
-      (unsigned long long)address, (unsigned long long)matches);
+    cl_log("Pointer search for " CL_FX64 " found " CL_FU64 " results ("
+      CL_FU64 " static) using " CL_FU64 " bytes.\n", (cl_uint64)address,
+      (cl_uint64)search->result_count, (cl_uint64)search->static_count,
+      (cl_uint64)search->memory_usage);
+  }
+  cl_ps_map_free(&map);
 
-    return CL_OK;
+  return CL_OK;
 }
 
 cl_addr_t cl_pointersearch_step(cl_pointersearch_t *search, const void *value)
 {
-  cl_pointersearch_result_t *result;
+  cl_pointersearch_block_t *block;
+  cl_search_compare_func_t function;
+  cl_ps_writer_t writer;
   cl_addr_t address;
-  cl_addr_t matches, final_value, valid_pointers;
-  cl_error compare_result;
-  cl_compare_type cmp_type;
-  unsigned i;
+  cl_addr_t valid_pointers;
+  cl_addr_t index, static_count;
+  cl_addr_t offsets[CL_POINTER_MAX_PASSES];
+  cl_error error = CL_OK;
+  unsigned char *validity;
+  unsigned value_size, i;
 
-  if (!search)
+  if (!search ||
+      cl_search_params_set_target(&search->params, value) != CL_OK)
     return 0;
 
-  cmp_type = search->params.compare_type;
-  matches = 0;
+  /* Values are read in host order, so never use the byteswapping kernels */
+  function = cl_search_compare_function(&search->params, CL_HOST_ENDIANNESS);
+  if (!function)
+    return search->result_count;
+  validity = (unsigned char*)malloc(CL_POINTERSEARCH_BLOCK_SIZE);
+  if (!validity)
+    return search->result_count;
+
+  value_size = search->params.value_size;
   valid_pointers = 0;
-  cl_log("Result count at start: %llu\n", (unsigned long long)search->result_count);
-  for (i = 0; i < search->result_count; i++)
+  index = 0;
+  static_count = 0;
+  cl_ps_writer_init(&writer, value_size, 0);
+  cl_log("Result count at start: " CL_FU64 "\n",
+    (cl_uint64)search->result_count);
+  for (block = search->first_block; block && error == CL_OK;
+       block = block->next)
   {
-    result  = &search->results[i];
+    cl_pointersearch_block_t *data = cl_ps_block_load(search, block);
+    cl_addr_t initial = 0;
+    unsigned pos = 0;
 
-    if (resolve_pointerresult(&address, result, search->passes) != CL_OK)
-      continue;
-    else if (cl_read_memory_value(&final_value, NULL, address, search->params.value_type) != CL_OK)
-      continue;
-    else
+    if (!data)
     {
-      result->value_current = final_value;
+      error = CL_ERR_CLIENT_RUNTIME;
+      break;
+    }
 
-      if (!value)
-      {
-        compare_result = search->params.value_type == CL_MEMTYPE_FLOAT ?
-          compare_to_nothing_float(result->value_previous, result->value_current, cmp_type) :
-          compare_to_nothing(result->value_previous, result->value_current, cmp_type);
-      }
-      else
+    /* Follow each chain and read its current value */
+    for (i = 0; i < data->count; i++)
+    {
+      void *current = CL_PS_VALUE(data->values_current, i, value_size);
+
+      pos = (unsigned)(cl_ps_decode_chain(&data->chains[pos], &initial,
+        offsets, search->passes) - data->chains);
+      memset(current, 0, value_size);
+      validity[i] =
+        resolve_pointerresult(&address, initial, offsets, search->passes) == CL_OK &&
+        cl_read_memory_value(current, NULL, address, search->params.value_type) == CL_OK;
+      if (validity[i])
       {
-        compare_result = search->params.value_type == CL_MEMTYPE_FLOAT ?
-          compare_to_value_float(result->value_previous, result->value_current, cmp_type, *((float*)value)) :
-          compare_to_value(result->value_previous, result->value_current, cmp_type, *((cl_addr_t*)value));
+        data->addresses[i] = address;
+        valid_pointers++;
       }
+    }
+
+    /* Filter the whole block at once */
+    function(data->values_current,
+             CL_PS_VALUE(data->values_current, data->count, value_size),
+             validity,
+             data->values_previous,
+             &search->params.target);
+
+    /* Keep the matches, which now have their current value as previous */
+    initial = 0;
+    pos = 0;
+    for (i = 0; i < data->count && error == CL_OK; i++, index++)
+    {
+      const void *current = CL_PS_VALUE(data->values_current, i, value_size);
 
-      if (compare_result == CL_OK)
+      pos = (unsigned)(cl_ps_decode_chain(&data->chains[pos], &initial,
+        offsets, search->passes) - data->chains);
+      if (validity[i])
       {
-        memcpy(&search->results[matches], result, sizeof(cl_pointersearch_result_t));
-        matches++;
+        error = cl_ps_writer_push(&writer, initial, offsets, search->passes,
+          data->addresses[i], current, current);
+        if (index < search->static_count)
+          static_count++;
       }
-      result->value_previous = result->value_current;
-      valid_pointers++;
     }
   }
-  /* All of the still valid results are grouped together, the rest of memory can be cleared */
-  search->result_count = matches;
-  search->results = (cl_pointersearch_result_t*)realloc(search->results, matches * sizeof(cl_pointersearch_result_t));
-  cl_log("Pointer search now has %llu matches across %llu valid pointers.\n",
-    (unsigned long long)matches, (unsigned long long)valid_pointers);
+  free(validity);
+
+  /* Keep the previous results rather than replace them with a partial set */
+  if (error != CL_OK)
+  {
+    cl_ps_writer_discard(&writer);
+    cl_log("Pointer search step failed, keeping " CL_FU64 " results.\n",
+      (cl_uint64)search->result_count);
+    return search->result_count;
+  }
+
+  /* Only the still valid results are kept, the rest of memory can be cleared */
+  cl_ps_writer_finish(&writer, search);
+  search->static_count = static_count;
+  cl_log("Pointer search now has " CL_FU64 " matches across " CL_FU64
+    " valid pointers.\n", (cl_uint64)search->result_count,
+    (cl_uint64)valid_pointers);
 
-  return matches;
+  return search->result_count;
 }
 
 void cl_pointersearch_update(cl_pointersearch_t *search)
 {
-  cl_pointersearch_result_t *result;
+  cl_pointersearch_block_t *block;
+  cl_addr_t offsets[CL_POINTER_MAX_PASSES];
+  unsigned value_size;
   unsigned i;
 
   if (!search)
     return;
 
-  for (i = 0; i < search->result_count; i++)
+  value_size = search->params.value_size;
+  for (block = search->first_block; block; block = block->next)
   {
-    result = &search->results[i];
+    cl_pointersearch_block_t *data = cl_ps_block_load(search, block);
+    cl_addr_t initial = 0;
+    unsigned pos = 0;
 
-    if (resolve_pointerresult(&result->address_final, result, search->passes) != CL_OK)
-      continue;
+    if (!data)
+      break;
+
+    for (i = 0; i < data->count; i++)
+    {
+      pos = (unsigned)(cl_ps_decode_chain(&data->chains[pos], &initial,
+        offsets, search->passes) - data->chains);
+
+      if (resolve_pointerresult(&data->addresses[i], initial, offsets, search->passes) != CL_OK)
+        continue;
+      else
+      {
+        void *current = CL_PS_VALUE(data->values_current, i, value_size);
+
+        memset(current, 0, value_size);
+        cl_read_memory_value(current, NULL, data->addresses[i], search->params.value_type);
+      }
+    }
+    cl_ps_block_store(search, block);
+  }
+}
+
+#if CL_HAVE_FILESYSTEM
+
+/* A fully decoded result, used to sort results before saving them */
+typedef struct
+{
+  cl_bool is_static;
+  cl_addr_t chain[CL_POINTER_MAX_PASSES + 1];
+  cl_addr_t address_final;
+  cl_search_target_t value_current;
+  cl_search_target_t value_previous;
+} cl_ps_entry_t;
+
+static int cl_ps_entry_compare(const void *a, const void *b)
+{
+  const cl_ps_entry_t *ea = (const cl_ps_entry_t*)a;
+  const cl_ps_entry_t *eb = (const cl_ps_entry_t*)b;
+  unsigned i;
+
+  if (ea->is_static != eb->is_static)
+    return ea->is_static ? -1 : 1;
+  for (i = 0; i < CL_POINTER_MAX_PASSES + 1; i++)
+    if (ea->chain[i] != eb->chain[i])
+      return ea->chain[i] < eb->chain[i] ? -1 : 1;
+
+  return 0;
+}
+
+/**
+ * Sorts the results of a search by initial address, then by offsets, keeping
+ * the results with static roots first.
+ */
+static cl_error cl_ps_sort(cl_pointersearch_t *search)
+{
+  cl_pointersearch_block_t *block;
+  cl_ps_entry_t *entries;
+  cl_ps_writer_t writer;
+  cl_addr_t count = 0;
+  cl_addr_t static_count = search->static_count;
+  cl_addr_t i;
+  unsigned value_size = search->params.value_size;
+
+  if (!search->result_count)
+    return CL_OK;
+  entries = (cl_ps_entry_t*)calloc(search->result_count, sizeof(cl_ps_entry_t));
+  if (!entries)
+    return CL_ERR_CLIENT_RUNTIME;
+
+  for (block = search->first_block; block; block = block->next)
+  {
+    cl_pointersearch_block_t *data = cl_ps_block_load(search, block);
+    cl_addr_t initial = 0;
+    unsigned pos = 0;
+    unsigned j;
+
+    if (!data)
+    {
+      free(entries);
+      return CL_ERR_CLIENT_RUNTIME;
+    }
+    for (j = 0; j < data->count && count < search->result_count; j++, count++)
+    {
+      cl_ps_entry_t *entry = &entries[count];
+
+      pos = (unsigned)(cl_ps_decode_chain(&data->chains[pos], &initial,
+        &entry->chain[1], search->passes) - data->chains);
+      entry->is_static = count < static_count;
+      entry->chain[0] = initial;
+      entry->address_final = data->addresses[j];
+      memcpy(entry->value_current.raw,
+        CL_PS_VALUE(data->values_current, j, value_size), value_size);
+      memcpy(entry->value_previous.raw,
+        CL_PS_VALUE(data->values_previous, j, value_size), value_size);
+    }
+  }
+  qsort(entries, count, sizeof(cl_ps_entry_t), cl_ps_entry_compare);
+
+  cl_ps_writer_init(&writer, value_size, 0);
+  for (i = 0; i < count; i++)
+  {
+    if (cl_ps_writer_push(&writer, entries[i].chain[0], &entries[i].chain[1],
+          search->passes, entries[i].address_final,
+          entries[i].value_current.raw, entries[i].value_previous.raw) != CL_OK)
+      break;
+  }
+  free(entries);
+  if (i != count)
+  {
+    cl_ps_writer_discard(&writer);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_ps_writer_finish(&writer, search);
+  search->static_count = static_count;
+
+  return CL_OK;
+}
+
+static cl_bool cl_ps_write_uint(FILE *file, cl_addr_t value, unsigned size)
+{
+  unsigned char bytes[8];
+  unsigned i;
+
+  for (i = 0; i < size; i++)
+    bytes[i] = (unsigned char)(i < sizeof(value) ? value >> (i * 8) : 0);
+
+  return fwrite(bytes, 1, size, file) == size;
+}
+
+static cl_addr_t cl_ps_read_uint(const unsigned char *src, unsigned size)
+{
+  cl_addr_t value = 0;
+  unsigned i;
+
+  for (i = 0; i < size && i < sizeof(value); i++)
+    value |= (cl_addr_t)src[i] << (i * 8);
+
+  return value;
+}
+
+/**
+ * Whether the chains of a block from a scan file hold exactly `count` chains
+ * and end exactly at `size`. Every varint ends on a byte without the
+ * continuation bit, and each chain is one varint per pass plus the initial
+ * address, so counting those bytes is enough to keep decoding in bounds.
+ */
+static cl_bool cl_ps_chains_valid(const unsigned char *chains, cl_addr_t size,
+  cl_addr_t count, unsigned passes)
+{
+  cl_addr_t varints = 0;
+  cl_addr_t i;
+
+  if (!size || (chains[size - 1] & 0x80))
+    return CL_FALSE;
+  for (i = 0; i < size; i++)
+    if (!(chains[i] & 0x80))
+      varints++;
+
+  return varints == count * (passes + 1);
+}
+
+/* The size of the fixed header at the start of a scan file */
+#define CL_PS_FILE_HEADER_SIZE 44
+
+/* The size of each memory region descriptor in a scan file */
+#define CL_PS_FILE_REGION_SIZE 24
+
+cl_error cl_pointersearch_save(cl_pointersearch_t *search, const char *path)
+{
+  cl_pointersearch_block_t *block;
+  cl_bool ok;
+  FILE *file;
+  unsigned i;
+
+  if (!search || !path)
+    return CL_ERR_PARAMETER_NULL;
+  else if (cl_ps_sort(search) != CL_OK)
+    return CL_ERR_CLIENT_RUNTIME;
+
+  file = fopen(path, "wb");
+  if (!file)
+    return CL_ERR_CLIENT_RUNTIME;
+
+  ok = fwrite(CL_POINTERSEARCH_FILE_MAGIC, 1, 4, file) == 4 &&
+       cl_ps_write_uint(file, CL_POINTERSEARCH_FILE_VERSION, 4) &&
+       cl_ps_write_uint(file, search->params.value_type, 4) &&
+       cl_ps_write_uint(file, search->passes, 4) &&
+       cl_ps_write_uint(file, memory.region_count, 4) &&
+       cl_ps_write_uint(file, search->range, 8) &&
+       cl_ps_write_uint(file, search->result_count, 8) &&
+       cl_ps_write_uint(file, search->static_count, 8);
+  for (i = 0; ok && i < memory.region_count; i++)
+  {
+    const cl_memory_region_t *region = &memory.regions[i];
+
+    ok = cl_ps_write_uint(file, region->base_guest, 8) &&
+         cl_ps_write_uint(file, region->size, 8) &&
+         cl_ps_write_uint(file, region->pointer_length, 4) &&
+         cl_ps_write_uint(file, region->endianness, 4);
+  }
+  ok = ok && cl_ps_write_uint(file, search->block_count, 4);
+  for (block = search->first_block; ok && block; block = block->next)
+    ok = cl_ps_write_uint(file, block->count, 4) &&
+         cl_ps_write_uint(file, block->chains_size, 4);
+  for (block = search->first_block; ok && block; block = block->next)
+  {
+    const cl_pointersearch_block_t *data = cl_ps_block_load(search, block);
+
+    ok = data && fwrite(data->chains, 1, data->chains_size, file) ==
+      data->chains_size;
+  }
+  if (fclose(file) != 0)
+    ok = CL_FALSE;
+
+  if (ok)
+    cl_log("Saved " CL_FU64 " pointer search results to %s.\n",
+      (cl_uint64)search->result_count, path);
+
+  return ok ? CL_OK : CL_ERR_CLIENT_RUNTIME;
+}
+
+cl_error cl_pointersearch_load(cl_pointersearch_t *search, const char *path)
+{
+  const unsigned char *data, *table, *chains;
+  cl_pointersearch_block_t *last = NULL;
+  cl_addr_t size, range, result_count, static_count, total_count, offset;
+  cl_value_type value_type;
+  unsigned passes, region_count, block_count, value_size;
+  cl_bool regions_match;
+  unsigned i;
+
+  if (!search || !path)
+    return CL_ERR_PARAMETER_NULL;
+
+  data = (const unsigned char*)cl_dma_map_file(path, &size);
+  if (!data)
+    return CL_ERR_PARAMETER_INVALID;
+
+  /* Validate the header */
+  if (size < CL_PS_FILE_HEADER_SIZE ||
+      memcmp(data, CL_POINTERSEARCH_FILE_MAGIC, 4) != 0 ||
+      cl_ps_read_uint(&data[4], 4) != CL_POINTERSEARCH_FILE_VERSION)
+    goto error;
+  value_type   = (cl_value_type)cl_ps_read_uint(&data[8], 4);
+  passes       = (unsigned)cl_ps_read_uint(&data[12], 4);
+  region_count = (unsigned)cl_ps_read_uint(&data[16], 4);
+  range        = cl_ps_read_uint(&data[20], 8);
+  result_count = cl_ps_read_uint(&data[28], 8);
+  static_count = cl_ps_read_uint(&data[36], 8);
+  value_size   = cl_sizeof_memtype(value_type);
+  if (value_size == 0 || value_size > sizeof(cl_search_target_t) ||
+      passes == 0 || passes > CL_POINTER_MAX_PASSES ||
+      static_count > result_count ||
+      region_count > (size - CL_PS_FILE_HEADER_SIZE) / CL_PS_FILE_REGION_SIZE)
+    goto error;
+
+  /* Check whether the scan was made with the same memory layout */
+  regions_match = region_count == memory.region_count;
+  for (i = 0; regions_match && i < region_count; i++)
+  {
+    const unsigned char *desc =
+      &data[CL_PS_FILE_HEADER_SIZE + i * CL_PS_FILE_REGION_SIZE];
+
+    regions_match =
+      cl_ps_read_uint(&desc[0], 8) == memory.regions[i].base_guest &&
+      cl_ps_read_uint(&desc[8], 8) == memory.regions[i].size &&
+      cl_ps_read_uint(&desc[16], 4) == memory.regions[i].pointer_length;
+  }
+  if (!regions_match)
+    cl_log("Pointer scan %s was made with different memory regions.\n", path);
+
+  /* Validate the block table */
+  offset = CL_PS_FILE_HEADER_SIZE + region_count * CL_PS_FILE_REGION_SIZE;
+  if (size - offset < 4)
+    goto error;
+  block_count = (unsigned)cl_ps_read_uint(&data[offset], 4);
+  table = &data[offset + 4];
+  if (block_count > (size - offset - 4) / 8)
+    goto error;
+  chains = table + block_count * 8;
+  offset = (cl_addr_t)(chains - data);
+  total_count = 0;
+  for (i = 0; i < block_count; i++)
+  {
+    cl_addr_t count = cl_ps_read_uint(&table[i * 8], 4);
+    cl_addr_t chains_size = cl_ps_read_uint(&table[i * 8 + 4], 4);
+
+    /* Decoding never checks bounds, so the chains are checked up front */
+    if (count == 0 || count > CL_POINTERSEARCH_BLOCK_SIZE ||
+        chains_size == 0 || chains_size > size - offset ||
+        !cl_ps_chains_valid(&data[offset], chains_size, count, passes))
+      goto error;
+    total_count += count;
+    offset += chains_size;
+  }
+  if (total_count != result_count)
+    goto error;
+
+  /* The file is valid, so replace any previous results with its blocks */
+  cl_ps_free_blocks(search);
+  memset(search, 0, sizeof(*search));
+  search->passes              = passes;
+  search->range               = range;
+  search->static_count        = static_count;
+  search->params.compare_type = CL_COMPARE_EQUAL;
+  search->params.value_size   = value_size;
+  search->params.value_type   = value_type;
+  search->params.target_ptr   = &search->params.target;
+  search->params.target_none  = 1;
+  search->file_data           = data;
+  search->file_size           = size;
+  for (i = 0; i < block_count; i++)
+  {
+    cl_pointersearch_block_t *block = (cl_pointersearch_block_t*)calloc(1,
+      sizeof(cl_pointersearch_block_t));
+
+    if (!block)
+    {
+      cl_pointersearch_free(search);
+      return CL_ERR_CLIENT_RUNTIME;
+    }
+    block->count       = (unsigned)cl_ps_read_uint(&table[i * 8], 4);
+    block->chains_size = (unsigned)cl_ps_read_uint(&table[i * 8 + 4], 4);
+    block->chains      = (unsigned char*)chains;
+    block->mapped      = CL_TRUE;
+    block->pending     = CL_TRUE;
+    chains += block->chains_size;
+    if (last)
+      last->next = block;
     else
-      cl_read_memory_value(&result->value_current, NULL, result->address_final, search->params.value_type);
+      search->first_block = block;
+    last = block;
+    search->block_count++;
+    search->result_count += block->count;
+    search->memory_usage += sizeof(*block);
   }
+  cl_log("Loaded " CL_FU64 " pointer search results from %s.\n",
+    (cl_uint64)search->result_count, path);
+
+  return CL_OK;
+
+error:
+  cl_log("%s is not a valid pointer scan.\n", path);
+  cl_dma_unmap_file(data, size);
+
+  return CL_ERR_PARAMETER_INVALID;
 }
+
+#endif
@@ -2,25 +2,34 @@
 #define CL_SEARCH_H
 
 #include "cl_memory.h"
+#include "cl_search_new.h"
 #include "cl_types.h"
 
 /**
- * Parameters used for pointer searches
+ * Decides which memory regions a pointer search scans for pointers.
+ * Regions with no flags set, such as emulated memory, are always scanned.
  */
 typedef struct
 {
-  /* The type of value being searched for */
-  cl_value_type value_type;
+  /* Flags a region must have all of to be scanned */
+  cl_memory_region_flags required;
 
-  /* The size, in bytes, of the value type */
-  unsigned value_size;
+  /* Flags a region must have none of to be scanned */
+  cl_memory_region_flags excluded;
 
-  /* The comparison method to use */
-  cl_compare_type compare_type;
-} cl_pointersearch_parameters_t;
+  /**
+   * Whether to only keep chains that start in a static region. Static
+   * regions are those backed by an executable image, plus writable regions
+   * directly following one, such as uninitialized data. Regions with no
+   * flags set always have fixed addresses and count as static.
+   */
+  cl_bool static_roots_only;
+} cl_pointersearch_filter_t;
 
 /**
  * A single pointer search result containing the pointer chain and values.
+ * Results are not stored in this form; use `cl_pointersearch_get_result` to
+ * decode one.
  */
 typedef struct
 {
@@ -31,15 +40,75 @@ typedef struct
   cl_addr_t address_final;
 
   /* The current value at the final address */
-  cl_addr_t value_current;
+  cl_counter_t value_current;
 
   /* The previous value at the final address */
-  cl_addr_t value_previous;
+  cl_counter_t value_previous;
 
   /* The offsets applied at each pointer level */
   cl_addr_t offsets[CL_POINTER_MAX_PASSES];
 } cl_pointersearch_result_t;
 
+typedef struct cl_pointersearch_block_t cl_pointersearch_block_t;
+
+/**
+ * A block of up to `CL_POINTERSEARCH_BLOCK_SIZE` pointer search results.
+ * Blocks are allocated as results are found, so a search only holds as much
+ * memory as it has results.
+ */
+struct cl_pointersearch_block_t
+{
+  /**
+   * The pointer chains of each result, one after another. Each chain is the
+   * difference from the previous chain's initial address followed by one
+   * offset per pass, all stored as variable-length integers, so shallow
+   * chains with small offsets take only a few bytes.
+   */
+  unsigned char *chains;
+
+  /* The number of bytes of `chains` in use */
+  unsigned chains_size;
+
+  /* The final address of each result, in the same order as the chains */
+  cl_addr_t *addresses;
+
+  /**
+   * The current and previous values of each result, as arrays of the
+   * search's value type. Kept as separate arrays so the comparison kernels
+   * from `cl_search_new.c` can filter a whole block at once.
+   */
+  void *values_current;
+  void *values_previous;
+
+  /* The number of results in this block */
+  unsigned count;
+
+  /**
+   * Whether the contents of this block have been moved to the spill file.
+   * If so, its arrays are NULL and must be loaded from the file to be read.
+   */
+  cl_bool spilled;
+
+  /* The position of this block's contents in the spill file */
+  long spill_offset;
+
+  /**
+   * Whether `chains` points into a loaded scan file rather than memory
+   * owned by the block.
+   */
+  cl_bool mapped;
+
+  /**
+   * Whether the addresses and values of this block have yet to be read from
+   * live memory. Set for blocks loaded from a scan file, which are validated
+   * the first time they are accessed.
+   */
+  cl_bool pending;
+
+  /* Next block in the linked list */
+  cl_pointersearch_block_t *next;
+};
+
 /**
  * The main pointer search structure.
  * Searches for pointer chains that lead to a target address.
@@ -47,7 +116,7 @@ typedef struct
 typedef struct
 {
   /* Search parameters */
-  cl_pointersearch_parameters_t params;
+  cl_search_parameters_t params;
 
   /* Number of pointer dereferences in the chain */
   unsigned passes;
@@ -55,14 +124,51 @@ typedef struct
   /* Maximum offset range to search for at each level */
   cl_addr_t range;
 
-  /* Array of found pointer chains */
-  cl_pointersearch_result_t *results;
+  /* The filter used to decide which memory regions to scan */
+  cl_pointersearch_filter_t filter;
+
+  /**
+   * The number of results at the start of the list whose chains start in a
+   * static region. These are the most likely to survive between sessions,
+   * so they are kept ahead of the rest.
+   */
+  cl_addr_t static_count;
+
+  /* The first block of found pointer chains */
+  cl_pointersearch_block_t *first_block;
+
+  /* The number of blocks in the linked list */
+  unsigned block_count;
 
   /* Number of results found */
   cl_addr_t result_count;
 
-  /* Maximum number of results to store */
+  /* Maximum number of results to store, or 0 for no limit */
   cl_addr_t max_results;
+
+  /* The memory held by the results, in bytes, excluding spilled blocks */
+  cl_addr_t memory_usage;
+
+  /**
+   * A temporary file blocks are moved into once `memory_usage` reaches
+   * `CL_POINTERSEARCH_SPILL_SIZE`, or NULL if nothing has been spilled.
+   */
+  void *spill;
+
+  /* The contents of a scan file the search was loaded from, if any */
+  const void *file_data;
+  cl_addr_t file_size;
+
+  /* The block currently loaded from the spill file, if any */
+  cl_pointersearch_block_t *spill_loaded;
+  cl_pointersearch_block_t spill_data;
+
+  /* A cursor to make sequential calls to `cl_pointersearch_get_result` fast */
+  cl_pointersearch_block_t *cursor_block;
+  cl_addr_t cursor_block_first;
+  cl_addr_t cursor_index;
+  cl_addr_t cursor_address;
+  unsigned cursor_pos;
 } cl_pointersearch_t;
 
 /**
@@ -79,18 +185,83 @@ cl_error cl_pointersearch_free(cl_pointersearch_t *search);
  * @param value_type The type of value at the target address
  * @param passes The number of pointer dereferences to search through
  * @param range The maximum offset range for each pointer level
- * @param max_results The maximum number of results to store
+ * @param max_results The maximum number of results to store, or 0 for no
+ *   limit
+ * @param filter A pointer to a filter for which regions to scan, or NULL to
+ *   scan every region that can hold pointers
  * @return CL_OK on success, or an error code on failure
  */
 cl_error cl_pointersearch_init(cl_pointersearch_t *search, cl_addr_t address,
   cl_value_type value_type, unsigned passes, cl_addr_t range,
-  cl_addr_t max_results);
+  cl_addr_t max_results, const cl_pointersearch_filter_t *filter);
+
+/**
+ * Decodes a single pointer search result.
+ * Sequential indices are decoded in constant time; other indices require
+ * walking the blocks from the start.
+ * @param search A pointer to the pointer search
+ * @param index The index of the result, less than `result_count`
+ * @param result A pointer to the result to decode into
+ * @return CL_OK on success, or an error code on failure
+ */
+cl_error cl_pointersearch_get_result(cl_pointersearch_t *search,
+  cl_addr_t index, cl_pointersearch_result_t *result);
+
+#if CL_HAVE_FILESYSTEM
+/**
+ * The identifier at the start of a pointer scan file.
+ */
+#define CL_POINTERSEARCH_FILE_MAGIC "CLPS"
+
+/**
+ * The version of the pointer scan file format. Files with another version
+ * are rejected.
+ */
+#define CL_POINTERSEARCH_FILE_VERSION 2
+
+/**
+ * Writes the results of a pointer search to a scan file so it can be
+ * reloaded in a later session. The results are sorted by their pointer
+ * chains as they are written, which also sorts them in the search itself.
+ * Results with static roots are kept first.
+ *
+ * All fields are little-endian. The file is laid out as:
+ * - The magic and version as 4-byte values.
+ * - The value type, pass count and region count as 4-byte values, then the
+ *   offset range, result count and static result count as 8-byte values.
+ * - For each memory region, its guest base address and size as 8-byte
+ *   values, then its pointer length and endianness as 4-byte values.
+ * - The block count as a 4-byte value, then the result count and chain
+ *   size of each block as 4-byte values.
+ * - The chains of each block, in the same encoding as in memory.
+ * @param search A pointer to the pointer search
+ * @param path The path of the file to write
+ * @return CL_OK on success, or an error code on failure
+ */
+cl_error cl_pointersearch_save(cl_pointersearch_t *search, const char *path);
+
+/**
+ * Initializes a pointer search from a scan file. The file is mapped rather
+ * than copied, and each block of results is only resolved against live
+ * memory the first time it is accessed.
+ * A warning is logged if the memory regions differ from those the scan was
+ * made with; chains that no longer resolve will be removed by the next step.
+ * The whole file is checked before it is used, so a truncated or corrupt
+ * file is rejected and leaves the search as it was. Otherwise, any results
+ * the search already held are freed.
+ * @param search A pointer to the pointer search to initialize, which must
+ *   hold a previous search or be zeroed
+ * @param path The path of the file to read
+ * @return CL_OK on success, or an error code on failure
+ */
+cl_error cl_pointersearch_load(cl_pointersearch_t *search, const char *path);
+#endif
 
 /**
  * Filters pointer search results based on value comparisons.
  * @param search A pointer to the pointer search
- * @param value A pointer to the value to compare against, or NULL to compare
- *   against previous values
+ * @param value A pointer to a value of the search's value type to compare
+ *   against, or NULL to compare against previous values
  * @return The number of matching results
  */
 cl_addr_t cl_pointersearch_step(cl_pointersearch_t *search, const void *value);
@@ -2,6 +2,7 @@
 
 #include "cl_abi.h"
 #include "cl_config.h"
+#include "cl_dma.h"
 #include "cl_memory.h"
 
 #include <stdint.h>
@@ -24,55 +25,6 @@ typedef union
 
 #define CL_TARGET(target) ((cl_search_target_impl_t *)&(target))
 
-#if CL_EXTERNAL_MEMORY
-
-#if CL_HOST_PLATFORM == _CL_PLATFORM_LINUX
-  #include <sys/mman.h>
-#elif CL_HOST_PLATFORM == _CL_PLATFORM_WINDOWS
-  #include <windows.h>
-#endif
-
-/**
- * Allocate a chunk of page-aligned memory.
- * @param size The number of bytes to allocate
- * @return A pointer to the bytes, or NULL
- */
-static void *cl_mmap(size_t size)
-{
-#if CL_HOST_PLATFORM == _CL_PLATFORM_LINUX
-  void *p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-
-  if (p == CL_ADDRESS_INVALID)
-    return NULL;
-  else
-    return p;
-#elif CL_HOST_PLATFORM == _CL_PLATFORM_WINDOWS
-  return VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-#else
-  return malloc(size);
-#endif
-}
-
-/**
- * Free a chunk of page-aligned memory.
- * @param p The pointer to free
- * @param size The number of bytes to deallocate
- */
-static void cl_munmap(void *p, size_t size)
-{
-#if CL_HOST_PLATFORM == _CL_PLATFORM_LINUX
-  munmap(p, size);
-#elif CL_HOST_PLATFORM == _CL_PLATFORM_WINDOWS
-  CL_UNUSED(size);
-  VirtualFree(p, 0, MEM_RELEASE);
-#else
-  CL_UNUSED(size);
-  free(p);
-#endif
-}
-
-#endif
-
 #define CL_PASTE2(a, b) a##b
 #define CL_PASTE3(a, b, c) a##b##c
 #define CL_PASTE4(a, b, c, d) a##b##c##d
@@ -370,8 +322,6 @@ CL_SEARCH_CMP_IMMEDIATE_UNROLL(int64_t, s64)
 CL_SEARCH_CMP_IMMEDIATE_UNROLL(float, fp)
 CL_SEARCH_CMP_IMMEDIATE_UNROLL(double, dfp)
 
-typedef unsigned (*cl_search_compare_func_t)(void*,const void*,unsigned char*,const void*,const void*);
-
 static cl_search_compare_func_t cl_search_comparison_function(
   cl_search_parameters_t params, cl_endianness endianness)
 {
@@ -736,6 +686,12 @@ static cl_search_compare_func_t cl_search_comparison_function(
   return NULL;
 }
 
+cl_search_compare_func_t cl_search_compare_function(
+  const cl_search_parameters_t *params, cl_endianness endianness)
+{
+  return params ? cl_search_comparison_function(*params, endianness) : NULL;
+}
+
 /**
  * Runs a comparison function on the values in a search page.
  * @param page
@@ -911,19 +867,20 @@ cl_error cl_search_change_value_type(cl_search_t *search, cl_value_type type)
   }
 }
 
-cl_error cl_search_change_target(cl_search_t *search, const void *value)
+cl_error cl_search_params_set_target(cl_search_parameters_t *params,
+  const void *value)
 {
-  if (!search)
+  if (!params)
     return CL_ERR_PARAMETER_NULL;
   else if (!value)
-    search->params.target_none = 1;
+    params->target_none = 1;
   else
   {
     cl_search_target_t target;
     cl_search_target_impl_t *target_impl = CL_TARGET(target);
 
     target_impl->s64 = 0;
-    switch (search->params.value_size)
+    switch (params->value_size)
     {
     case 1:
       target_impl->s8 = *(const int8_t*)value;
@@ -940,13 +897,21 @@ cl_error cl_search_change_target(cl_search_t *search, const void *value)
     default:
       return CL_ERR_PARAMETER_INVALID;
     }
-    search->params.target = target;
-    search->params.target_none = 0;
+    params->target = target;
+    params->target_none = 0;
   }
 
   return CL_OK;
 }
 
+cl_error cl_search_change_target(cl_search_t *search, const void *value)
+{
+  if (!search)
+    return CL_ERR_PARAMETER_NULL;
+  else
+    return cl_search_params_set_target(&search->params, value);
+}
+
 static cl_error cl_search_free_page(cl_search_page_t *page)
 {
   if (page)
@@ -1073,7 +1038,7 @@ static cl_error cl_search_step_first(cl_search_t *search)
   unsigned i;
 
 #if CL_EXTERNAL_MEMORY
-  bucket = cl_mmap(CL_SEARCH_BUCKET_SIZE);
+  bucket = cl_dma_map(CL_SEARCH_BUCKET_SIZE);
   if (!bucket)
     return CL_ERR_CLIENT_RUNTIME;
 #endif
@@ -1172,7 +1137,7 @@ static cl_error cl_search_step_first(cl_search_t *search)
   search->steps = 1;
 
 #if CL_EXTERNAL_MEMORY
-  cl_munmap(bucket, CL_SEARCH_BUCKET_SIZE);
+  cl_dma_unmap(bucket, CL_SEARCH_BUCKET_SIZE);
 #endif
   cl_search_profile_memory(search);
   search->time_taken = ((double)(clock() - start)) / CLOCKS_PER_SEC;
@@ -94,6 +94,33 @@ typedef struct
   unsigned target_none;
 } cl_search_parameters_t;
 
+/**
+ * A comparison kernel. Compares each value from `data` to `end` against the
+ * matching value in `prev` or against `target`, clearing the matching byte
+ * in `validity` for each value that fails.
+ * @return The number of values that are still valid
+ */
+typedef unsigned (*cl_search_compare_func_t)(void *data, const void *end,
+  unsigned char *validity, const void *prev, const void *target);
+
+/**
+ * Returns the comparison kernel to use for the given parameters.
+ * @param params The search parameters
+ * @param endianness The endianness of the values being compared
+ * @return A comparison kernel, or NULL if the parameters are invalid
+ */
+cl_search_compare_func_t cl_search_compare_function(
+  const cl_search_parameters_t *params, cl_endianness endianness);
+
+/**
+ * Sets the target value of a set of search parameters.
+ * @param params The search parameters to modify. `value_size` must be set.
+ * @param value A pointer to a value of the parameters' value type, or NULL to
+ *   compare against the previous value instead
+ */
+cl_error cl_search_params_set_target(cl_search_parameters_t *params,
+  const void *value);
+
 /** 
  * The main structure representing an ongoing memory search.
  * Upon creating a search, call `cl_search_init` to initialize it.
@@ -1,9 +1,14 @@
 #include "cl_abi.h"
 #include "cl_counter.h"
+#include "cl_dma.h"
 #include "cl_main.h"
 #include "cl_memory.h"
 #include "cl_network.h"
+#include "cl_profile.h"
+#include "cl_script.h"
+#include "cl_search.h"
 #include "cl_search_new.h"
+#include "cl_test.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +16,7 @@
 #include <time.h>
 
 #define CL_TEST_DATA_SIZE 128
+#define CL_TEST_SCAN_PATH "cl_test.clps"
 #define CL_TEST_REGION_COUNT 4
 
 #ifndef CL_TEST_REGION_SIZE
@@ -24,10 +30,51 @@ typedef struct
   cl_game_identifier_t identifier;
 } cl_test_system_t;
 
+/**
+ * The script served by the fake server: one page that posts achievement 1 when
+ * memory note 1 equals 5. The server also sends memory note 3, which no
+ * action reads, and rich presence note 4.
+ */
+#define CL_TEST_SCRIPT "1 2 0 15 5 1 1 0 5 1 1 18 2 0 1"
+
+/* A script that only reads memory note 1, copying it into counter 0 */
+#define CL_TEST_SCRIPT_REFERENCE "1 1 0 5 3 0 1 1"
+
+/**
+ * A script that copies the largest value of memory note 1 over the last 3
+ * frames into counter 0.
+ */
+#define CL_TEST_SCRIPT_HISTORY "1 1 0 24 4 0 1 1 3"
+
+/* CL_TEST_SCRIPT in the binary encoding, as base64url */
+#define CL_TEST_SCRIPT_BINARY "AQECAA8FAgIACgIBEgIAAg"
+
+/**
+ * A script in the binary encoding that sets counter 0 to -300, to check
+ * negative arguments are decoded.
+ */
+#define CL_TEST_SCRIPT_BINARY_NEGATIVE "AQEBAAUDAADXBA"
+
+/**
+ * A script for the load-time analysis: counter 0 is set to 7, a condition
+ * that never passes guards an addition to it, and a condition that always
+ * passes guards an addition to counter 1. Only that last addition should be
+ * left to run every frame.
+ */
+#define CL_TEST_SCRIPT_ANALYSIS "1 5 " \
+  "0 5 3 0 0 7 " \
+  "0 15 5 0 1 0 2 1 " \
+  "1 1 3 0 0 1 " \
+  "0 15 5 0 3 0 3 1 " \
+  "1 1 3 1 0 1"
+
 static cl_test_system_t cl_test_system;
 static unsigned cl_test_thread_depth = 0;
 static char cl_test_msg[256];
 
+/* The data sent with the last achievement post */
+static char cl_test_achievement_data[1024];
+
 static cl_error cl_test_display_message(unsigned level, const char *msg)
 {
   const char *level_str;
@@ -119,15 +166,20 @@ static cl_error cl_test_network_post(const char *url, char *data,
   }
   else if (strstr(url, CL_CLINT_URL CL_END_CLINT_START))
   {
-    response.data =
+    /* Built in pieces, as C89 compilers need not allow longer literals */
+    static const char *game =
       "{"
         "\"success\":true,"
         "\"game_id\":1,"
         "\"title\":\"Test Game\","
         "\"memory_notes\":"
         "["
-          "{\"id\":1,\"type\":8,\"offsets\":\"1 4\",\"address\":268435456}"
-        "],"
+          "{\"id\":1,\"type\":8,\"offsets\":\"1 4\",\"address\":268435456},"
+          "{\"id\":3,\"type\":8,\"offsets\":\"0\",\"address\":268435712},"
+          "{\"id\":4,\"type\":8,\"offsets\":\"0\",\"address\":268435716,"
+            "\"flags\":1}"
+        "],";
+    static const char *unlocks =
         "\"achievements\":"
         "["
           "{\"id\":1,\"title\":\"High Five\",\"description\":\""
@@ -139,12 +191,19 @@ static cl_error cl_test_network_post(const char *url, char *data,
         "["
           "{\"leaderboard_id\":1,\"title\":\"High Scores\",\"description\":\""
             "Top scores for the game.\"}"
-        "],"
-        "\"script\":\"1 2 0 15 5 1 1 0 5 1 1 18 2 0 1\""
-      "}\n";
+        "],";
+    static char start[1024];
+
+    /* Clients that read binary scripts get one, with text as a fallback */
+    snprintf(start, sizeof(start), "%s%s%s\"script\":\"" CL_TEST_SCRIPT "\"}\n",
+      game, unlocks, data && strstr(data, "binary_script=1") ?
+        "\"binary_script\":\"" CL_TEST_SCRIPT_BINARY "\"," : "");
+    response.data = start;
   }
   else if (strstr(url, CL_CLINT_URL CL_END_CLINT_ACHIEVEMENT))
   {
+    snprintf(cl_test_achievement_data, sizeof(cl_test_achievement_data),
+      "%s", data ? data : "");
     response.data =
       "{"
         "\"success\":true"
@@ -270,6 +329,32 @@ static cl_error cl_test_external_write_value(const void *src, cl_addr_t address,
   return cl_write_memory_value_internal(src, NULL, address, type);
 }
 
+static cl_error cl_test_external_read_scatter(cl_memory_span_t *spans,
+  unsigned count)
+{
+  unsigned i;
+
+  snprintf(cl_test_msg, sizeof(cl_test_msg),
+    "cl_abi_external_read_scatter - spans:%p count:%u",
+    (void*)spans, count);
+  cl_test_display_message(CL_MSG_DEBUG, cl_test_msg);
+
+  for (i = 0; i < count; i++)
+  {
+    const cl_memory_region_t *region = cl_find_memory_region(spans[i].address);
+
+    /* Only read spans that fit entirely within one region */
+    spans[i].read = 0;
+    if (region && spans[i].address >= region->base_guest &&
+        spans[i].address - region->base_guest + spans[i].size <= region->size &&
+        cl_read_memory_buffer_internal(spans[i].dest, region,
+          spans[i].address - region->base_guest, spans[i].size) == CL_OK)
+      spans[i].read = spans[i].size;
+  }
+
+  return CL_OK;
+}
+
 static const cl_abi_t cl_test_abi =
 {
   CL_ABI_VERSION,
@@ -287,7 +372,8 @@ static const cl_abi_t cl_test_abi =
       cl_test_external_read_buffer,
       cl_test_external_read_value,
       cl_test_external_write_buffer,
-      cl_test_external_write_value
+      cl_test_external_write_value,
+      cl_test_external_read_scatter
     }
   }
 };
@@ -351,6 +437,58 @@ static cl_error cl_test_console_init(void)
   return CL_OK;
 }
 
+/* The target of the two-pass pointer search tests */
+#define CL_TEST_POINTER_TARGET 0x20000100
+
+/**
+ * Checks that a two-pass pointer search result starts at `initial` and
+ * reaches the test target through the given offsets.
+ */
+static cl_bool cl_test_pointer_result(cl_pointersearch_t *search,
+  cl_addr_t index, cl_addr_t initial, cl_addr_t first, cl_addr_t second,
+  unsigned value)
+{
+  cl_pointersearch_result_t result;
+
+  return cl_pointersearch_get_result(search, index, &result) == CL_OK &&
+    result.address_initial == initial &&
+    result.offsets[0] == first && result.offsets[1] == second &&
+    result.address_final == CL_TEST_POINTER_TARGET &&
+    result.value_current.intval.i64 == value;
+}
+
+#if CL_HAVE_FILESYSTEM
+/**
+ * Loads a copy of the test pointer scan with its last `drop` bytes removed,
+ * and with the byte at `patch` incremented unless it is negative, to check
+ * the copy is rejected.
+ */
+static cl_bool cl_test_scan_rejected(cl_pointersearch_t *search,
+  unsigned drop, int patch)
+{
+  unsigned char bytes[1024];
+  size_t size;
+  FILE *file;
+
+  file = fopen(CL_TEST_SCAN_PATH, "rb");
+  if (!file)
+    return CL_FALSE;
+  size = fread(bytes, 1, sizeof(bytes), file);
+  fclose(file);
+  if (drop > size || patch >= (int)size)
+    return CL_FALSE;
+  else if (patch >= 0)
+    bytes[patch]++;
+  file = fopen(CL_TEST_SCAN_PATH ".bad", "wb");
+  if (!file)
+    return CL_FALSE;
+  fwrite(bytes, 1, size - drop, file);
+  fclose(file);
+
+  return cl_pointersearch_load(search, CL_TEST_SCAN_PATH ".bad") != CL_OK;
+}
+#endif
+
 static cl_error cl_test_console_free(void)
 {
   unsigned i;
@@ -364,9 +502,104 @@ static cl_error cl_test_console_free(void)
   return CL_OK;
 }
 
+cl_error cl_test_replay(cl_script_t *script, cl_memory_trace_t *trace,
+  cl_test_replay_t *report)
+{
+  cl_test_replay_t results;
+  unsigned *executions;
+  cl_action_id *types;
+  cl_uint64 ticks = 0;
+  cl_error error;
+  unsigned action_count = 0;
+  unsigned frame, i, j, k;
+
+  if (!script || !trace)
+    return CL_ERR_PARAMETER_NULL;
+  for (i = 0; i < script->page_count; i++)
+    action_count += script->pages[i].action_count;
+  executions = (unsigned*)calloc(action_count + 1, sizeof(unsigned));
+  types = (cl_action_id*)calloc(action_count + 1, sizeof(cl_action_id));
+  if (!executions || !types)
+  {
+    free(executions);
+    free(types);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  error = cl_memory_trace_replay(trace);
+  memset(&results, 0, sizeof(results));
+
+  for (frame = 0; error == CL_OK && frame < trace->frame_count; frame++)
+  {
+    cl_uint64 start;
+
+    /* Actions can change type as they run, so note what each one was */
+    for (i = 0, k = 0; i < script->page_count; i++)
+      for (j = 0; j < script->pages[i].action_count; j++, k++)
+      {
+        executions[k] = script->pages[i].actions[j].executions;
+        types[k] = script->pages[i].actions[j].type;
+      }
+
+    start = cl_profile_ticks();
+    cl_update_memory();
+    error = cl_script_update(script);
+    ticks += cl_profile_ticks() - start;
+
+    for (i = 0, k = 0; i < script->page_count; i++)
+      for (j = 0; j < script->pages[i].action_count; j++, k++)
+      {
+        const cl_action_t *action = &script->pages[i].actions[j];
+
+        if (action->if_type || types[k] == CL_ACTTYPE_NO_PROCESS ||
+            action->executions == executions[k])
+          continue;
+        printf(" - Frame %u: page %u action %u (type %u) fired\n",
+          frame, i, j, types[k]);
+        results.fired++;
+        results.last_fired_frame = frame;
+      }
+  }
+  cl_memory_trace_replay(NULL);
+  free(executions);
+  free(types);
+
+  results.frames = frame;
+  results.seconds = cl_profile_seconds(ticks);
+  if (results.seconds > 0)
+    printf("Replayed %u frames in %.6f s (%.0f frames per second).\n",
+      results.frames, results.seconds, results.frames / results.seconds);
+  else
+    printf("Replayed %u frames.\n", results.frames);
+  if (report)
+    *report = results;
+
+  return error;
+}
+
 cl_error cl_test(void)
 {
   cl_search_t search;
+  cl_pointersearch_t pointer_search;
+  cl_pointersearch_result_t pointer_result;
+  cl_pointersearch_filter_t pointer_filter;
+  cl_memory_region_flags region_flags[CL_TEST_REGION_COUNT];
+#if CL_HAVE_FILESYSTEM
+  cl_pointersearch_t loaded_search;
+#endif
+  cl_counter_t stats[CL_HISTORY_SIZE];
+  cl_memory_write_queue_t writes;
+  const cl_memory_history_t *history;
+  cl_memory_snapshot_t before, after;
+  cl_memory_range_t *ranges;
+  unsigned range_count;
+  const cl_addr_t flips[] = { 0x20000010, 0x20000011, 0x40000020 };
+  cl_memory_trace_t trace;
+  cl_test_replay_t replay;
+  cl_script_t other;
+  const char *script_pos;
+#if CL_HAVE_PROFILER
+  cl_profile_entry_t profile[3];
+#endif
   clock_t start, end;
   double cpu_time_used;
   int error;
@@ -459,6 +692,171 @@ cl_error cl_test(void)
   else
     printf("Big-endian virtual memory read/write test passed (got 0x%02X)!\n", byte);
 
+  printf("============================================================\n");
+  printf("Performing memory note lookup tests...\n");
+  if (cl_find_memnote(1) != &memory.notes[0] || cl_find_memnote(2) ||
+      cl_find_memnote(CL_MEMNOTE_KEY_MAX + 1))
+  {
+    printf("Memory note lookup test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Memory note lookup test passed!\n");
+
+  printf("Performing memory note change tests...\n");
+  cl_update_memory();
+  cl_update_memory();
+  if (cl_memory_note_changed(0) || memory.changed_count != 0)
+  {
+    printf("Memory note change test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Memory note change test passed!\n");
+
+  printf("Performing memory note history tests...\n");
+  if (cl_memory_history_request(1, 3) != CL_OK ||
+      !(history = cl_memory_history_find(1, 3)))
+  {
+    printf("Memory note history setup failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+
+  /* The test memory note reads 4 bytes past the pointer at 0x10000000 */
+  word = 0x30000000;
+  cl_write_memory_value(&word, NULL, 0x10000000, CL_MEMTYPE_UINT32);
+  word = 5;
+  cl_write_memory_value(&word, NULL, 0x30000004, CL_MEMTYPE_UINT32);
+  cl_update_memory();
+  word = 9;
+  cl_write_memory_value(&word, NULL, 0x30000004, CL_MEMTYPE_UINT32);
+  cl_update_memory();
+  word = 1;
+  cl_write_memory_value(&word, NULL, 0x30000004, CL_MEMTYPE_UINT32);
+  cl_update_memory();
+  cl_update_memory();
+  for (i = 0; i < CL_HISTORY_SIZE; i++)
+    cl_memory_history_query(&stats[i], history, (cl_history_stat)i);
+  if (stats[CL_HISTORY_MIN].intval.i64 != 1 ||
+      stats[CL_HISTORY_MAX].intval.i64 != 9 ||
+      stats[CL_HISTORY_SUM].intval.i64 != 11 ||
+      stats[CL_HISTORY_HELD].intval.i64 != 1)
+  {
+    printf("Memory note history test failed (min " CL_FS64 ", max " CL_FS64
+      ", sum " CL_FS64 ", held " CL_FS64 ")!\n",
+      stats[CL_HISTORY_MIN].intval.i64, stats[CL_HISTORY_MAX].intval.i64,
+      stats[CL_HISTORY_SUM].intval.i64, stats[CL_HISTORY_HELD].intval.i64);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Memory note history test passed!\n");
+  memset(&other, 0, sizeof(other));
+  script_pos = CL_TEST_SCRIPT_HISTORY;
+  error = cl_script_init(&other, &script_pos);
+  if (error == CL_OK)
+    error = cl_script_update(&other);
+  if (error != CL_OK ||
+      cl_memory_history_at(other.pages[0].actions[0].history) != history ||
+      other.pages[0].counters[0].intval.i64 != 9)
+  {
+    printf("Memory note history action test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Memory note history action test passed!\n");
+  cl_script_free(&other);
+
+  printf("Performing action operand binding tests...\n");
+  if (script.pages[0].actions[0].operands[0].value !=
+        cl_memory_note_value(1, CL_SRCTYPE_CURRENT_RAM) ||
+      script.pages[0].actions[0].operands[1].value->intval.i64 != 5)
+  {
+    printf("Action operand binding test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Action operand binding test passed!\n");
+
+  printf("Performing page counter tests...\n");
+  if (script.pages[0].counter_count != 0 || !script.counters)
+  {
+    printf("Page counter test failed (%u counters)!\n",
+      script.pages[0].counter_count);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Page counter test passed!\n");
+
+  printf("Performing fused step tests...\n");
+  if (!script.pages[0].steps[0].fused)
+  {
+    printf("Fused step test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Fused step test passed!\n");
+
+  printf("Performing memory note write queue tests...\n");
+  memset(&writes, 0, sizeof(writes));
+  cl_ctr_store_int(&stats[0], 7);
+  cl_ctr_store_float(&stats[1], 3.9);
+  cl_write_memnote_from_key(&writes, 1, &stats[0]);
+  cl_write_memnote_from_key(&writes, 1, &stats[1]);
+  cl_read_memory_value(&word, NULL, 0x30000004, CL_MEMTYPE_UINT32);
+  if (word != 1)
+  {
+    printf("Memory note write queue test failed (written before flush)!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_memory_flush_writes(&writes);
+  cl_read_memory_value(&word, NULL, 0x30000004, CL_MEMTYPE_UINT32);
+  if (word != 3)
+  {
+    printf("Memory note write queue test failed (got %u)!\n", word);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_ctr_store_float(&stats[1], 1e30);
+  cl_write_memnote_from_key(&writes, 1, &stats[1]);
+  cl_memory_flush_writes(&writes);
+  cl_read_memory_value(&word, NULL, 0x30000004, CL_MEMTYPE_UINT32);
+  if (word != 0xFFFFFFFF)
+  {
+    printf("Memory note write queue test failed (clamped to %u)!\n", word);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Memory note write queue test passed!\n");
+  cl_memory_write_queue_free(&writes);
+
+  printf("Performing memory snapshot diff tests...\n");
+  if (cl_memory_snapshot_init(&before, NULL, NULL) != CL_OK ||
+      cl_memory_snapshot_capture(&before) != CL_OK ||
+      cl_memory_snapshot_init(&after, NULL, NULL) != CL_OK)
+  {
+    printf("Memory snapshot setup failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  for (i = 0; i < sizeof(flips) / sizeof(flips[0]); i++)
+  {
+    cl_read_memory_value(&byte, NULL, flips[i], CL_MEMTYPE_UINT8);
+    byte ^= 0xFF;
+    cl_write_memory_value(&byte, NULL, flips[i], CL_MEMTYPE_UINT8);
+  }
+  cl_memory_snapshot_capture(&after);
+  if (cl_memory_snapshot_diff(&before, &after, &ranges, &range_count) != CL_OK ||
+      range_count != 2 ||
+      ranges[0].address != 0x20000010 || ranges[0].size != 2 ||
+      ranges[1].address != 0x40000020 || ranges[1].size != 1)
+  {
+    printf("Memory snapshot diff test failed (%u ranges)!\n", range_count);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Memory snapshot diff test passed!\n");
+  cl_dma_free(ranges);
+  cl_memory_snapshot_free(&before);
+  cl_memory_snapshot_free(&after);
+
   printf("============================================================\n");
   printf("Initializing memory search...");
   cl_search_init(&search);
@@ -526,19 +924,346 @@ cl_error cl_test(void)
   printf("Freeing search...\n");
   cl_search_free(&search);
 
+  printf("============================================================\n");
+  printf("Performing pointer search tests...\n");
+  word = 0x20000000;
+  cl_write_memory_value(&word, NULL, 0x10000000, CL_MEMTYPE_UINT32);
+  word = 42;
+  cl_write_memory_value(&word, NULL, 0x20000008, CL_MEMTYPE_UINT32);
+  if (cl_pointersearch_init(&pointer_search, 0x20000008, CL_MEMTYPE_UINT32,
+        1, 0x100, 0, NULL) != CL_OK ||
+      pointer_search.result_count != 1)
+  {
+    printf("Pointer search init test failed (" CL_FU64 " results)!\n",
+      (cl_uint64)pointer_search.result_count);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  word = 43;
+  cl_write_memory_value(&word, NULL, 0x20000008, CL_MEMTYPE_UINT32);
+  if (cl_pointersearch_step(&pointer_search, &word) != 1 ||
+      cl_pointersearch_get_result(&pointer_search, 0, &pointer_result) != CL_OK ||
+      pointer_result.address_initial != 0x10000000 ||
+      pointer_result.offsets[0] != 8 ||
+      pointer_result.address_final != 0x20000008 ||
+      pointer_result.value_current.intval.i64 != 43)
+  {
+    printf("Pointer search step test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+#if CL_HAVE_FILESYSTEM
+  memset(&loaded_search, 0, sizeof(loaded_search));
+  if (cl_pointersearch_save(&pointer_search, CL_TEST_SCAN_PATH) != CL_OK ||
+      cl_pointersearch_load(&loaded_search, CL_TEST_SCAN_PATH) != CL_OK ||
+      loaded_search.result_count != 1 ||
+      cl_pointersearch_get_result(&loaded_search, 0, &pointer_result) != CL_OK ||
+      pointer_result.address_initial != 0x10000000 ||
+      pointer_result.offsets[0] != 8 ||
+      pointer_result.value_current.intval.i64 != 43)
+  {
+    printf("Pointer scan file test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+
+  /* Drop the last byte, then claim each chain has one more offset */
+  if (!cl_test_scan_rejected(&loaded_search, 1, -1) ||
+      !cl_test_scan_rejected(&loaded_search, 0, 12) ||
+      loaded_search.result_count != 1 ||
+      cl_pointersearch_get_result(&loaded_search, 0, &pointer_result) != CL_OK)
+  {
+    printf("Pointer scan file rejection test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_pointersearch_free(&loaded_search);
+  remove(CL_TEST_SCAN_PATH);
+  remove(CL_TEST_SCAN_PATH ".bad");
+#endif
+  word = 44;
+  if (cl_pointersearch_step(&pointer_search, &word) != 0)
+  {
+    printf("Pointer search filter test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_pointersearch_free(&pointer_search);
+  printf("Pointer search tests passed!\n");
+
+  /**
+   * Region 0 is an executable image, so it is static. Regions 1 and 2 are
+   * dynamic, and region 2 is a mapped file the filter leaves out. A pointer
+   * in region 1 leads to the target, and one pointer in each of regions 0, 1
+   * and 2 leads to that.
+   */
+  printf("Performing pointer search filter tests...\n");
+  for (i = 0; i < CL_TEST_REGION_COUNT; i++)
+  {
+    region_flags[i] = memory.regions[i].flags;
+    memory.regions[i].flags.raw = 0;
+  }
+  memory.regions[0].flags.bits.commit = 1;
+  memory.regions[0].flags.bits.read = 1;
+  memory.regions[0].flags.bits.image = 1;
+  memory.regions[1].flags.bits.commit = 1;
+  memory.regions[1].flags.bits.read = 1;
+  memory.regions[1].flags.bits.write = 1;
+  memory.regions[1].flags.bits.privated = 1;
+  memory.regions[2].flags = memory.regions[1].flags;
+  memory.regions[2].flags.bits.privated = 0;
+  memory.regions[2].flags.bits.mapped = 1;
+  word = 77;
+  cl_write_memory_value(&word, NULL, CL_TEST_POINTER_TARGET, CL_MEMTYPE_UINT32);
+  word = CL_TEST_POINTER_TARGET - 0x10;
+  cl_write_memory_value(&word, NULL, 0x20000200, CL_MEMTYPE_UINT32);
+  word = 0x20000200 - 8;
+  cl_write_memory_value(&word, NULL, 0x10000100, CL_MEMTYPE_UINT32);
+  word = 0x20000200 - 4;
+  cl_write_memory_value(&word, NULL, 0x20000300, CL_MEMTYPE_UINT32);
+  word = 0x20000200;
+  cl_write_memory_value(&word, NULL, 0x30000100, CL_MEMTYPE_UINT32);
+
+  /* Static roots come first, and results are read backwards across blocks */
+  if (cl_pointersearch_init(&pointer_search, CL_TEST_POINTER_TARGET,
+        CL_MEMTYPE_UINT32, 2, 0x80, 0, NULL) != CL_OK ||
+      pointer_search.result_count != 3 || pointer_search.static_count != 1 ||
+      pointer_search.block_count != (3 + CL_POINTERSEARCH_BLOCK_SIZE - 1) /
+        CL_POINTERSEARCH_BLOCK_SIZE ||
+      !cl_test_pointer_result(&pointer_search, 2, 0x30000100, 0, 0x10, 77) ||
+      !cl_test_pointer_result(&pointer_search, 0, 0x10000100, 8, 0x10, 77) ||
+      !cl_test_pointer_result(&pointer_search, 1, 0x20000300, 4, 0x10, 77))
+  {
+    printf("Pointer search multiple pass test failed (" CL_FU64 " results, "
+      CL_FU64 " static)!\n", (cl_uint64)pointer_search.result_count,
+      (cl_uint64)pointer_search.static_count);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  word = 78;
+  cl_write_memory_value(&word, NULL, CL_TEST_POINTER_TARGET, CL_MEMTYPE_UINT32);
+  if (cl_pointersearch_step(&pointer_search, &word) != 3 ||
+      !cl_test_pointer_result(&pointer_search, 1, 0x20000300, 4, 0x10, 78) ||
+      !cl_test_pointer_result(&pointer_search, 0, 0x10000100, 8, 0x10, 78))
+  {
+    printf("Pointer search multiple pass step test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_pointersearch_free(&pointer_search);
+
+  /* Leave out mapped regions, then also chains that start in dynamic ones */
+  memset(&pointer_filter, 0, sizeof(pointer_filter));
+  pointer_filter.required.bits.read = 1;
+  pointer_filter.excluded.bits.mapped = 1;
+  if (cl_pointersearch_init(&pointer_search, CL_TEST_POINTER_TARGET,
+        CL_MEMTYPE_UINT32, 2, 0x80, 0, &pointer_filter) != CL_OK ||
+      pointer_search.result_count != 2 || pointer_search.static_count != 1 ||
+      !cl_test_pointer_result(&pointer_search, 0, 0x10000100, 8, 0x10, 78) ||
+      !cl_test_pointer_result(&pointer_search, 1, 0x20000300, 4, 0x10, 78))
+  {
+    printf("Pointer search region filter test failed (" CL_FU64
+      " results)!\n", (cl_uint64)pointer_search.result_count);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_pointersearch_free(&pointer_search);
+  pointer_filter.static_roots_only = CL_TRUE;
+  if (cl_pointersearch_init(&pointer_search, CL_TEST_POINTER_TARGET,
+        CL_MEMTYPE_UINT32, 2, 0x80, 0, &pointer_filter) != CL_OK ||
+      pointer_search.result_count != 1 || pointer_search.static_count != 1 ||
+      !cl_test_pointer_result(&pointer_search, 0, 0x10000100, 8, 0x10, 78))
+  {
+    printf("Pointer search static root test failed (" CL_FU64
+      " results)!\n", (cl_uint64)pointer_search.result_count);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_pointersearch_free(&pointer_search);
+  for (i = 0; i < CL_TEST_REGION_COUNT; i++)
+    memory.regions[i].flags = region_flags[i];
+  printf("Pointer search filter tests passed!\n");
+
   printf("============================================================\n");
   printf("Running simulated frames...\n");
   printf("Achievement should unlock between 4 and 5...\n");
+  error = cl_memory_trace_init(&trace);
+  if (error != CL_OK)
+    return error;
   word = 0x20000000;
   cl_write_memory_value(&word, NULL, 0x10000000, CL_MEMTYPE_UINT32);
+  cl_test_achievement_data[0] = '\0';
   for (i = 0; i < 10; i++)
   {
+    /* Rich presence note 4 changes every frame, between pings */
+    word = 100 + i;
+    cl_write_memory_value(&word, NULL, 0x10000104, CL_MEMTYPE_UINT32);
     cl_write_memory_value(&i, NULL, 0x20000004, CL_MEMTYPE_UINT32);
     cl_run();
+    cl_memory_trace_record(&trace);
     cl_read_memory_value(&word, NULL, 0x20000004, CL_MEMTYPE_UINT32);
     printf(" - Frame %u completed, memory at 0x20000004 = 0x%08x\n", i, word);
   }
 
+  printf("Performing rich presence post tests...\n");
+  if (!strstr(cl_test_achievement_data, "&m4=105"))
+  {
+    printf("Rich presence post test failed (sent \"%s\")!\n",
+      cl_test_achievement_data);
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Rich presence post test passed!\n");
+
+  printf("Performing idle page tests...\n");
+  cl_run();
+  cl_run();
+  if (script.pages[0].dirty)
+  {
+    printf("Idle page test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Idle page test passed!\n");
+
+  printf("Performing memory note reference tests...\n");
+  cl_script_free(&script);
+  script_pos = CL_TEST_SCRIPT_REFERENCE;
+  if (cl_memory_reset_references() != CL_OK ||
+      cl_script_init(&script, &script_pos) != CL_OK)
+  {
+    printf("Memory note reference setup failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  stats[0] = *cl_memory_note_value(3, CL_SRCTYPE_CURRENT_RAM);
+  stats[1] = *cl_memory_note_value(4, CL_SRCTYPE_CURRENT_RAM);
+  word = stats[0].intval.i64 + 1;
+  cl_write_memory_value(&word, NULL, 0x10000100, CL_MEMTYPE_UINT32);
+  word = stats[1].intval.i64 + 1;
+  cl_write_memory_value(&word, NULL, 0x10000104, CL_MEMTYPE_UINT32);
+  word = 31;
+  cl_write_memory_value(&word, NULL, 0x20000004, CL_MEMTYPE_UINT32);
+  cl_update_memory();
+  if (cl_memory_note_value(1, CL_SRCTYPE_CURRENT_RAM)->intval.i64 != 31 ||
+      cl_memory_note_value(3, CL_SRCTYPE_CURRENT_RAM)->intval.i64 !=
+        stats[0].intval.i64 ||
+      cl_memory_note_value(4, CL_SRCTYPE_CURRENT_RAM)->intval.i64 !=
+        stats[1].intval.i64)
+  {
+    printf("Memory note reference test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+
+  /* Rich presence notes are only included in the next update */
+  cl_memory_include_flag(CL_MEMFLAG_RICH);
+  cl_update_memory();
+  if (cl_memory_note_value(4, CL_SRCTYPE_CURRENT_RAM)->intval.i64 !=
+        stats[1].intval.i64 + 1 ||
+      cl_memory_note_value(3, CL_SRCTYPE_CURRENT_RAM)->intval.i64 !=
+        stats[0].intval.i64)
+  {
+    printf("Memory note include test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  word = stats[1].intval.i64 + 2;
+  cl_write_memory_value(&word, NULL, 0x10000104, CL_MEMTYPE_UINT32);
+  cl_update_memory();
+  if (cl_memory_note_value(4, CL_SRCTYPE_CURRENT_RAM)->intval.i64 !=
+        stats[1].intval.i64 + 1)
+  {
+    printf("Memory note include test failed (included twice)!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Memory note reference tests passed!\n");
+
+  printf("Performing script analysis tests...\n");
+  cl_script_free(&script);
+  script_pos = CL_TEST_SCRIPT_ANALYSIS;
+  error = cl_script_init(&script, &script_pos);
+  if (error == CL_OK)
+    error = cl_script_update(&script);
+  if (error != CL_OK || script.pages[0].step_count != 1 ||
+      script.pages[0].steps[0].action != &script.pages[0].actions[4] ||
+      script.pages[0].setup_count != 1 ||
+      script.pages[0].counters[0].intval.i64 != 7 ||
+      script.pages[0].counters[1].intval.i64 != 1)
+  {
+    printf("Script analysis test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Script analysis test passed!\n");
+
+  printf("Performing multiple script tests...\n");
+  memset(&other, 0, sizeof(other));
+  error = cl_script_init_binary(&other, CL_TEST_SCRIPT_BINARY_NEGATIVE,
+    sizeof(CL_TEST_SCRIPT_BINARY_NEGATIVE) - 1);
+  if (error == CL_OK)
+    error = cl_script_update(&other);
+  cl_script_break(&other, CL_FALSE, "Multiple script test break");
+  if (error != CL_OK || other.pages[0].counters[0].intval.i64 != -300 ||
+      other.status != CL_SCRIPT_STATUS_PAUSED ||
+      script.status != CL_SCRIPT_STATUS_ACTIVE ||
+      script.pages[0].counters[0].intval.i64 != 7 ||
+      script.pages[0].counters[1].intval.i64 != 1)
+  {
+    printf("Multiple script test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_script_free(&other);
+  if (cl_script_update(&script) != CL_OK || other.pages ||
+      script.pages[0].counters[0].intval.i64 != 7)
+  {
+    printf("Multiple script free test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  printf("Multiple script tests passed!\n");
+
+  printf("Performing binary script tests...\n");
+  cl_script_free(&script);
+  error = cl_script_init_binary(&script, CL_TEST_SCRIPT_BINARY_NEGATIVE,
+    sizeof(CL_TEST_SCRIPT_BINARY_NEGATIVE) - 1);
+  if (error != CL_OK || script.page_count != 1 ||
+      script.pages[0].action_count != 1 ||
+      script.pages[0].actions[0].arguments[2].intval != -300 ||
+      script.pages[0].counters[0].intval.i64 != -300)
+  {
+    printf("Binary script test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_script_free(&script);
+  if (cl_script_init_binary(&script, "AgEB", 4) == CL_OK)
+  {
+    printf("Binary script version test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  cl_script_free(&script);
+  printf("Binary script tests passed!\n");
+
+  printf("Performing memory trace replay tests...\n");
+  printf("Achievement should unlock on frame 5 again...\n");
+  cl_script_free(&script);
+  script_pos = CL_TEST_SCRIPT;
+  error = cl_script_init(&script, &script_pos);
+  if (error == CL_OK)
+    error = cl_test_replay(&script, &trace, &replay);
+  cl_memory_trace_free(&trace);
+  if (error != CL_OK || replay.frames != 10 || replay.fired != 1 ||
+      replay.last_fired_frame != 5 || memory.replay)
+  {
+    printf("Memory trace replay test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Memory trace replay test passed!\n");
+
+#if CL_HAVE_PROFILER
+  printf("Performing script profiler tests...\n");
+  if (cl_script_profile(&script, NULL, 0) != 3 ||
+      cl_script_profile(&script, profile, 3) != 3 ||
+      profile[0].action != CL_PROFILE_PAGE || profile[0].profile.count == 0)
+  {
+    printf("Script profiler test failed!\n");
+    return CL_ERR_CLIENT_RUNTIME;
+  }
+  else
+    printf("Script profiler test passed (page %u ran %u times for %.6f s)!\n",
+      profile[0].page, profile[0].profile.count,
+      cl_profile_seconds(profile[0].profile.total));
+#endif
+
   printf("============================================================\n");
   printf("Freeing test session...\n");
   error = cl_free();
@@ -1,3 +1,35 @@
+#include "cl_script.h"
 #include "cl_types.h"
 
+/**
+ * The results of replaying a memory trace with `cl_test_replay`.
+ */
+typedef struct
+{
+  /* The number of frames replayed */
+  unsigned frames;
+
+  /* The number of times an action other than a condition fired */
+  unsigned fired;
+
+  /* The frame the last of those actions fired on */
+  unsigned last_fired_frame;
+
+  /* The time spent updating memory and running the script, in seconds */
+  double seconds;
+} cl_test_replay_t;
+
 cl_error cl_test(void);
+
+/**
+ * Replays every frame of a memory trace through a loaded script as fast as
+ * possible, without reading memory. Prints each action other than a condition
+ * that fires along with the frame it fired on, then the number of frames
+ * replayed per second.
+ * @param script A pointer to the script to run.
+ * @param trace A pointer to the trace to replay.
+ * @param report A pointer to the results to fill, or NULL.
+ * @return CL_OK on success, or an error code on failure.
+ */
+cl_error cl_test_replay(cl_script_t *script, cl_memory_trace_t *trace,
+  cl_test_replay_t *report);
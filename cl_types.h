@@ -490,6 +490,188 @@ typedef struct cl_memory_region_t
   char title[256];
 } cl_memory_region_t;
 
+/**
+ * Reads a single value from host memory into `dst`, converting it from the
+ * endianness of the memory it was read from.
+ */
+typedef void (*cl_memory_reader_t)(void *dst, const void *src);
+
+/**
+ * One read in a memory note's read plan, either of a pointer or of the final
+ * value. The memory region the last read fell within is cached, so following
+ * reads within it skip the region lookup and endianness checks.
+ */
+typedef struct
+{
+  /* The guest base address of the cached region */
+  cl_addr_t base_guest;
+
+  /**
+   * The number of offsets from `base_guest` a whole value can be read from,
+   * or 0 if no region is cached.
+   */
+  cl_addr_t limit;
+
+  /* The host base address of the cached region */
+  const unsigned char *base_host;
+
+  /* The reader matching the value size and the region's endianness */
+  cl_memory_reader_t reader;
+
+  /* The size of the value to read, in bytes */
+  unsigned size;
+} cl_memnote_read_t;
+
+/**
+ * A contiguous range of external memory to be read as part of a batch.
+ */
+typedef struct
+{
+  /* The virtual address to read from */
+  cl_addr_t address;
+
+  /* The buffer to read into */
+  void *dest;
+
+  /* The number of bytes to read */
+  unsigned size;
+
+  /* Set to the number of bytes successfully read */
+  unsigned read;
+} cl_memory_span_t;
+
+/**
+ * A node in the tree of pointer chains shared between memory notes. Each node
+ * reads one pointer, so notes sharing a base pointer and leading offsets only
+ * read those pointers once per frame.
+ */
+typedef struct
+{
+  /* The index of the parent node, or `CL_MEMORY_CHAIN_ROOT` */
+  unsigned parent;
+
+  /* The number of pointers read before this one in the chain */
+  unsigned depth;
+
+  /**
+   * For a root node, the address to read a pointer from. Otherwise, the
+   * offset added to the parent's pointer to get that address.
+   */
+  cl_addr_t offset;
+
+  /* The cached read of this node's pointer */
+  cl_memnote_read_t read;
+
+  /* The pointer read by this node on the current frame */
+  cl_addr_t pointer;
+
+  /* Whether `pointer` could be read on the current frame */
+  cl_bool valid;
+
+  /* Whether a note being updated this frame reads through this node */
+  cl_bool needed;
+} cl_memory_chain_t;
+
+#define CL_MEMORY_CHAIN_ROOT (~0U)
+
+/**
+ * A statistic that can be queried from the recent values of a memory note.
+ */
+typedef enum
+{
+  /* The lowest value in the window */
+  CL_HISTORY_MIN = 0,
+
+  /* The highest value in the window */
+  CL_HISTORY_MAX,
+
+  /* The sum of every value in the window */
+  CL_HISTORY_SUM,
+
+  /* The number of updates since the value last changed */
+  CL_HISTORY_HELD,
+
+  CL_HISTORY_SIZE
+} cl_history_stat;
+
+/**
+ * A window of the most recent values of one memory note, kept for scripts to
+ * query statistics from. The values are a ring buffer, and the minimum and
+ * maximum are tracked with monotonic deques of frame numbers, so every
+ * statistic costs O(1) amortized time per frame rather than a scan of the
+ * window. Storage for all histories is allocated together as one arena.
+ */
+typedef struct
+{
+  /* The index of the memory note this history records */
+  unsigned note;
+
+  /* The number of frames in the window */
+  unsigned length;
+
+  /* The number of values recorded, up to `length` */
+  unsigned count;
+
+  /**
+   * The number of frames recorded in total. The ring slot of a frame is its
+   * number modulo `length`.
+   */
+  unsigned frame;
+
+  /* The values in the window, as a ring buffer of `length` entries */
+  cl_counter_t *values;
+
+  /**
+   * The frame numbers of the candidates for the window's minimum and maximum,
+   * as ring buffers of `length` entries. Values in each deque only get larger
+   * or smaller from the front, so the front is always the answer.
+   */
+  unsigned *min_deque;
+  unsigned min_head;
+  unsigned min_count;
+  unsigned *max_deque;
+  unsigned max_head;
+  unsigned max_count;
+
+  /* The sum of the values in the window */
+  cl_counter_t sum;
+
+  /* The number of updates since the value last changed */
+  unsigned held;
+} cl_memory_history_t;
+
+/**
+ * The values of a set of memory notes recorded over a number of frames, so a
+ * script can be run against them again without the content that produced
+ * them. See `cl_memory_trace_record` and `cl_memory_trace_replay`.
+ */
+typedef struct cl_memory_trace_t
+{
+  /* The keys of the recorded memory notes, in the order of their values */
+  unsigned *keys;
+  unsigned note_count;
+
+  /* The recorded values, `note_count` per frame */
+  cl_counter_t *values;
+  unsigned frame_count;
+  unsigned frame_capacity;
+
+  /**
+   * The index in the global memory context of each recorded note, or
+   * `UINT_MAX` if no note has its key. Set by `cl_memory_trace_replay`.
+   */
+  unsigned *indices;
+
+  /* The next frame to be replayed */
+  unsigned position;
+} cl_memory_trace_t;
+
+/**
+ * The highest key a memory note can have. Keys are small enough that notes can
+ * be looked up through a table indexed by key.
+ */
+#define CL_MEMNOTE_KEY_MAX 9999
+
 /**
  * A "memory note" or "memnote" is a point in core memory that corresponds
  * with an observable in-game value. Instead of accessing specific addreses
@@ -526,15 +708,27 @@ typedef struct cl_memnote_t
   /* The data type this memory note represents */
   cl_value_type type;
 
-  /* Stored values */
-  cl_counter_t current;
-  cl_counter_t previous;
-  cl_counter_t last_unique;
-
   /* For following pointers to get RAM values */
   unsigned pointer_offsets[CL_POINTER_MAX_PASSES];
   unsigned pointer_passes;
 
+  /**
+   * The plan used to read this memory note: one read per pointer pass, then
+   * one of the final value. Built by `cl_memory_compile_notes`. The pointer
+   * reads are only used when resolving this note alone, such as for writes;
+   * each frame they are read through the shared chain tree instead.
+   */
+  cl_memnote_read_t plan[CL_POINTER_MAX_PASSES + 1];
+
+  /* The index of the chain node holding this note's last pointer */
+  unsigned chain;
+
+  /**
+   * The value of `cl_memory_t.frame` when `address` was last resolved, so
+   * writes on the same frame do not follow the pointers again.
+   */
+  unsigned resolved_frame;
+
 #if CL_HAVE_EDITOR
   /* Metadata for generated human-readable strings in Live Editor */
   cl_memnote_ex_t details;
@@ -551,6 +745,72 @@ typedef struct cl_memory_t
   cl_memnote_t *notes;
   unsigned note_count;
 
+  /**
+   * A table of `CL_MEMNOTE_KEY_MAX + 1` entries mapping each memory note key
+   * to its index in `notes` plus one, or 0 if no note has that key.
+   */
+  unsigned *note_lookup;
+
+  /**
+   * The pointer chains of every memory note, merged into a tree and ordered
+   * so each node comes after its parent.
+   */
+  cl_memory_chain_t *chains;
+  unsigned chain_count;
+
+  /**
+   * The values of each memory note, indexed the same as `notes`. These are
+   * kept in their own arrays so the values updated every frame are packed
+   * together rather than spread between the metadata of each note.
+   */
+  cl_counter_t *values_current;
+  cl_counter_t *values_previous;
+  cl_counter_t *values_last_unique;
+
+  /**
+   * A bitset with one bit per memory note, set if its value changed on the
+   * last update.
+   */
+  unsigned char *changed;
+
+  /* The number of memory notes whose value changed on the last update */
+  unsigned changed_count;
+
+  /* The windows of recent values requested by the script */
+  cl_memory_history_t *histories;
+  unsigned history_count;
+
+  /* The single allocation backing the ring buffers of every history */
+  void *history_arena;
+
+  /**
+   * A bitset with one bit per memory note, set if the script reads it, or
+   * NULL to update every note. Notes that are not set are skipped by
+   * `cl_update_memory` and keep their last values.
+   */
+  unsigned char *referenced;
+
+  /**
+   * Memory note flags, in the same form as `cl_memnote_t.flags`, whose notes
+   * are updated on the next update even if the script does not read them.
+   */
+  unsigned include_flags;
+
+  /**
+   * Memory note flags whose notes are updated every frame while the script
+   * is loaded, as if it read them.
+   */
+  unsigned reference_flags;
+
+  /* The number of times `cl_update_memory` has run */
+  unsigned frame;
+
+  /**
+   * A trace whose values replace reading memory in `cl_update_memory`, or
+   * NULL to read memory as normal.
+   */
+  cl_memory_trace_t *replay;
+
   cl_memory_region_t *regions;
   unsigned region_count;
 } cl_memory_t;
@@ -22,6 +22,7 @@ SOURCES += \
     $$CL_DIR/cl_main.c \
     $$CL_DIR/cl_memory.c \
     $$CL_DIR/cl_network.c \
+    $$CL_DIR/cl_profile.c \
     $$CL_DIR/cl_script.c \
     $$CL_DIR/cl_search.c \
     $$CL_DIR/cl_search_new.c \
@@ -40,6 +41,7 @@ HEADERS += \
     $$CL_DIR/cl_main.h \
     $$CL_DIR/cl_memory.h \
     $$CL_DIR/cl_network.h \
+    $$CL_DIR/cl_profile.h \
     $$CL_DIR/cl_script.h \
     $$CL_DIR/cl_search.h \
     $$CL_DIR/cl_search_new.h \
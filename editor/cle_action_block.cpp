@@ -10,6 +10,7 @@
 extern "C"
 {
   #include "../cl_common.h"
+  #include "../cl_script.h"
 }
 
 CleActionBlock::CleActionBlock(cl_action_t *action, QWidget *parent = nullptr)
@@ -159,6 +160,26 @@ void CleActionBlock::paintEvent(QPaintEvent *e)
     painter.drawRect(0, 0, 4, height());
   }
 
+#if CL_HAVE_PROFILER
+  /* Shade the block by its share of script time to show hot actions */
+  if (m_Action && m_Action->profile.count && script.profile.total)
+  {
+    double share = static_cast<double>(m_Action->profile.total) /
+                   script.profile.total;
+    double average = cl_profile_seconds(m_Action->profile.total) /
+                     m_Action->profile.count;
+    QRect rect(width() - 96, 1, 94, height() - 2);
+
+    painter.setBrush(QColor(255, 96, 0, static_cast<int>(share * 192)));
+    painter.setPen(Qt::NoPen);
+    painter.drawRect(rect);
+    painter.setPen(Qt::white);
+    painter.drawText(rect, Qt::AlignRight | Qt::AlignVCenter,
+      QString("%1% %2us ").arg(share * 100, 0, 'f', 1)
+                          .arg(average * 1000000, 0, 'f', 2));
+  }
+#endif
+
   if (m_SnapDirection != CLE_SNAP_NONE)
   {
     QLinearGradient gradient(0, 0, width(), 4);
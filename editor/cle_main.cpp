@@ -58,5 +58,8 @@ void cle_init()
 void cle_run()
 {
   m_MemoryNotes->update();
+#if CL_HAVE_PROFILER
+  m_ScriptEditor->update();
+#endif
 }
 }
@@ -1,3 +1,4 @@
+#include <QFileDialog>
 #include <QMessageBox>
 
 #include "cle_memory_inspector.h"
@@ -349,6 +350,12 @@ void CleMemoryInspector::onRightClickTabs(const QPoint &pos)
 
       connect(action_rename, SIGNAL(triggered()), this,
         SLOT(onClickTabRename()));
+#if CL_HAVE_FILESYSTEM
+      QAction *action_load = menu.addAction(tr("&Load pointer scan..."));
+
+      connect(action_load, SIGNAL(triggered()), this,
+        SLOT(onClickLoadPointerScan()));
+#endif
 
       menu.exec(m_Tabs->mapToGlobal(pos));
     }
@@ -402,15 +409,40 @@ void CleMemoryInspector::requestPointerSearch(cl_addr_t address)
   if (dlg.exec() != QDialog::Accepted)
     return;
 
-  m_Searches[m_TabCount] = new CleResultTablePointer(
+  addPointerTable(new CleResultTablePointer(
     this,
     address,
     getCurrentSizeType(),
     dlg.pointerFollows(),
     dlg.offsetRange(),
     dlg.maxMatches()
-  );
+  ));
+}
+
+void CleMemoryInspector::onClickLoadPointerScan()
+{
+#if CL_HAVE_FILESYSTEM
+  QString path = QFileDialog::getOpenFileName(this, tr("Load pointer scan"),
+    QString(), tr("Pointer scans (*.clps)"));
+  CleResultTablePointer *table;
+
+  if (path.isEmpty())
+    return;
+  table = new CleResultTablePointer(this, path);
+  if (!table->loaded())
+  {
+    delete table;
+    QMessageBox::warning(this, tr("Load pointer scan"),
+      tr("%1 is not a valid pointer scan.").arg(path));
+    return;
+  }
+  addPointerTable(table);
+#endif
+}
 
+void CleMemoryInspector::addPointerTable(CleResultTablePointer *table)
+{
+  m_Searches[m_TabCount] = table;
   m_TabCount++;
   m_TableStack->addWidget(m_Searches[m_TabCount-1]->table());
   applyTheme(m_Searches[m_TabCount-1]->table());
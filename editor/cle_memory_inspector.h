@@ -28,6 +28,8 @@ extern "C"
 
 #define CLE_MAX_TABS 8
 
+class CleResultTablePointer;
+
 class CleMemoryInspector : public QWidget
 {
    Q_OBJECT
@@ -70,6 +72,7 @@ private:
 
    cl_compare_type getCurrentCompareType(void);
    cl_value_type getCurrentSizeType(void);
+   void    addPointerTable(CleResultTablePointer *table);
    void    applyTheme(QWidget *w);
    void    rebuildLayout(void);
 
@@ -80,6 +83,7 @@ private slots:
    void onChangeScrollbar(int value);
    void onChangeSizeType();
    void onChangeTab();
+   void onClickLoadPointerScan();
    void onClickNew();
    void onClickSearch();
    void onClickTabRename();
@@ -4,6 +4,7 @@ extern "C"
 {
   #include "../cl_json.h"
   #include "../cl_network.h"
+  #include "../cl_script.h"
 }
 
 static CL_NETWORK_CB(cle_memory_note_add_cb)
@@ -19,7 +20,8 @@ static CL_NETWORK_CB(cle_memory_note_add_cb)
     {
       cl_memnote_t *note = (cl_memnote_t*)userdata;
       note->key = memory_note_id;
-      cl_memory_add_note(note);
+      if (cl_memory_add_note(note) == CL_OK)
+        cl_script_bind(&script);
     }
     free(userdata);
   }
@@ -48,7 +48,7 @@ void CleMemoryNotes::rebuild(void)
 
     // Convert address and values to strings
     QString addr = QString("%1").arg((qulonglong)note->address, 8, 16, QChar('0')).toUpper();
-    QString val  = QString::number(note->current.intval.raw);
+    QString val  = QString::number(memory.values_current[i].intval.raw);
     QString type = QString::number(note->type);
     QString key  = QString::number(note->key);
     QString offsets;
@@ -88,14 +88,14 @@ void CleMemoryNotes::update(void)
     {
       /* Format note value */
       if (note->type == CL_MEMTYPE_FLOAT || note->type == CL_MEMTYPE_DOUBLE)
-        valueItem->setText(QString::number(note->current.floatval.fp));
+        valueItem->setText(QString::number(memory.values_current[i].floatval.fp));
       else
-        valueItem->setText(QString::number(note->current.intval.raw));
+        valueItem->setText(QString::number(memory.values_current[i].intval.raw));
 
       /* Check for known values from description */
       while (value->title[0] != '\0')
       {
-        if (note->current.intval.raw == value->value)
+        if (memory.values_current[i].intval.raw == value->value)
         {
           valueItem->setText(valueItem->text() + " (" + value->title + ")");
           break;
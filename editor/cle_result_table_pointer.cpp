@@ -1,3 +1,4 @@
+#include <QFileDialog>
 #include <QMenu>
 #include <QScrollBar>
 
@@ -6,8 +7,7 @@
 
 /** @todo everything here was dummied in anticipation of a pointersearch redo */
 
-CleResultTablePointer::CleResultTablePointer(QWidget *parent, cl_addr_t address,
-   cl_value_type value_type, unsigned passes, cl_addr_t range, cl_addr_t max_results)
+void CleResultTablePointer::initTable(QWidget *parent, unsigned passes)
 {
    char offset_str[16];
    unsigned i;
@@ -39,11 +39,32 @@ CleResultTablePointer::CleResultTablePointer(QWidget *parent, cl_addr_t address,
       parent, SLOT(requestAddMemoryNote(cl_memnote_t)));
    connect(this, SIGNAL(requestPointerSearch(cl_addr_t)),
       parent, SLOT(requestPointerSearch(cl_addr_t)));
+}
+
+CleResultTablePointer::CleResultTablePointer(QWidget *parent, cl_addr_t address,
+   cl_value_type value_type, unsigned passes, cl_addr_t range, cl_addr_t max_results)
+{
+   initTable(parent, passes);
 
-   if (cl_pointersearch_init(&m_Search, address, value_type, passes, range, max_results) != CL_OK)
+   memset(&m_Search, 0, sizeof(m_Search));
+   if (cl_pointersearch_init(&m_Search, address, value_type, passes, range, max_results, NULL) != CL_OK)
    {
       cl_log("Failed to initialize pointer search for address %016llX\n", (unsigned long long)address);
    }
+   else
+      m_Loaded = true;
+   rebuild();
+}
+
+CleResultTablePointer::CleResultTablePointer(QWidget *parent, const QString& path)
+{
+   memset(&m_Search, 0, sizeof(m_Search));
+#if CL_HAVE_FILESYSTEM
+   m_Loaded = cl_pointersearch_load(&m_Search, path.toUtf8().constData()) == CL_OK;
+#else
+   Q_UNUSED(path);
+#endif
+   initTable(parent, m_Loaded ? m_Search.passes : 1);
    rebuild();
 }
 
@@ -54,7 +75,12 @@ CleResultTablePointer::~CleResultTablePointer()
 
 cl_addr_t CleResultTablePointer::getClickedResultAddress()
 {
-   return m_Search.results[m_Table->currentRow()].address_final;
+   cl_pointersearch_result_t result;
+
+   if (cl_pointersearch_get_result(&m_Search, m_Table->currentRow(), &result) != CL_OK)
+      return 0;
+
+   return result.address_final;
 }
 
 void *CleResultTablePointer::searchData(void)
@@ -65,15 +91,31 @@ void *CleResultTablePointer::searchData(void)
 void CleResultTablePointer::onClickResultAddMemoryNote()
 {
    cl_memnote_t note;
+   cl_pointersearch_result_t result;
 
-   note.address_initial = m_Search.results[m_ClickedResult].address_initial;
+   if (cl_pointersearch_get_result(&m_Search, m_ClickedResult, &result) != CL_OK)
+      return;
+
+   note.address_initial = result.address_initial;
    note.type = m_Search.params.value_type;
-   memcpy(note.pointer_offsets, m_Search.results[m_ClickedResult].offsets, sizeof(note.pointer_offsets));
+   memcpy(note.pointer_offsets, result.offsets, sizeof(note.pointer_offsets));
    note.pointer_passes = m_Search.passes;
 
    emit requestAddMemoryNote(note);
 }
 
+void CleResultTablePointer::onClickSaveScan()
+{
+#if CL_HAVE_FILESYSTEM
+   QString path = QFileDialog::getSaveFileName(m_Table, tr("Save pointer scan"),
+      QString(), tr("Pointer scans (*.clps)"));
+
+   if (!path.isEmpty())
+      cl_pointersearch_save(&m_Search, path.toUtf8().constData());
+   rebuild();
+#endif
+}
+
 void CleResultTablePointer::onResultRightClick(const QPoint& pos)
 {
    if (pos.isNull())
@@ -90,6 +132,12 @@ void CleResultTablePointer::onResultRightClick(const QPoint& pos)
 
          connect(action_add, SIGNAL(triggered()), this, 
             SLOT(onClickResultAddMemoryNote()));
+#if CL_HAVE_FILESYSTEM
+         QAction *action_save   = menu.addAction(tr("&Save pointer scan..."));
+
+         connect(action_save, SIGNAL(triggered()), this,
+            SLOT(onClickSaveScan()));
+#endif
 
          menu.exec(m_Table->mapToGlobal(pos));
       }
@@ -99,14 +147,16 @@ void CleResultTablePointer::onResultRightClick(const QPoint& pos)
 /* TODO: Allow seeking to multiple steps */
 void CleResultTablePointer::onResultClick(QTableWidgetItem *item)
 {
-   if (!item)
+   cl_pointersearch_result_t result;
+
+   if (!item || cl_pointersearch_get_result(&m_Search, item->row(), &result) != CL_OK)
       return;
    else
    {
       if (item->column() == 0)
-         emit addressChanged(m_Search.results[item->row()].address_initial);
+         emit addressChanged(result.address_initial);
       else
-         emit addressChanged(m_Search.results[item->row()].address_final);
+         emit addressChanged(result.address_final);
    }
 }
 
@@ -129,9 +179,12 @@ void CleResultTablePointer::onResultEdited(QTableWidgetItem *item)
 #if 0
    if (item->row() == m_CurrentEditedRow && item->column() == m_ColValueCurr)
    {
-      if (item->isSelected())
+      cl_pointersearch_result_t result;
+
+      if (item->isSelected() &&
+          cl_pointersearch_get_result(&m_Search, item->row(), &result) == CL_OK)
       {
-         writeMemory(m_Search.results[item->row()].address_final, 
+         writeMemory(result.address_final, 
             m_Search.params, item->text());
       }
       m_CurrentEditedRow = -1;
@@ -144,6 +197,7 @@ cl_error CleResultTablePointer::rebuild(void)
   return CL_OK;
 #if 0
    char     temp_string[32];
+   cl_pointersearch_result_t result;
    unsigned size;
    unsigned current_row, i, j;
    cl_addr_t temp_value;
@@ -154,21 +208,23 @@ cl_error CleResultTablePointer::rebuild(void)
 
    for (i = 0; i < m_Search.result_count; i++)
    {
+      if (cl_pointersearch_get_result(&m_Search, i, &result) != CL_OK)
+         break;
       m_Table->insertRow(i);
 
-      snprintf(temp_string, 256, "%016llX", (unsigned long long)m_Search.results[i].address_initial);
+      snprintf(temp_string, 256, "%016llX", (unsigned long long)result.address_initial);
       m_Table->setItem(i, m_ColAddress, new QTableWidgetItem(QString(temp_string)));
 
       for (j = 0; j < m_Search.passes; j++)
       {
-         snprintf(temp_string, 256, "%llX", (unsigned long long)m_Search.results[i].offsets[j]);
+         snprintf(temp_string, 256, "%llX", (unsigned long long)result.offsets[j]);
          m_Table->setItem(i, j + 1, new QTableWidgetItem(QString(temp_string)));
       }
 
-      valueToString(temp_string, sizeof(temp_string), m_Search.results[i].value_previous, size);
+      valueToString(temp_string, sizeof(temp_string), result.value_previous, size);
       m_Table->setItem(i, m_ColValuePrev, new QTableWidgetItem(QString(temp_string)));
 
-      valueToString(temp_string, sizeof(temp_string), m_Search.results[i].value_current, size);
+      valueToString(temp_string, sizeof(temp_string), result.value_current, size);
       m_Table->setItem(i, m_ColValueCurr, new QTableWidgetItem(QString(temp_string)));
    }
 #endif
@@ -184,6 +240,7 @@ cl_error CleResultTablePointer::run(void)
 #if 0
    QTableWidgetItem *item;
    char     temp_string[32];
+   cl_pointersearch_result_t result;
    cl_value_type val_type;
    cl_addr_t address, value_curr, value_prev;
    unsigned i;
@@ -205,9 +262,11 @@ cl_error CleResultTablePointer::run(void)
       else if (i > m_Table->verticalScrollBar()->value() 
           + m_Table->size().height() / 16)
          break;
+      else if (cl_pointersearch_get_result(&m_Search, i, &result) != CL_OK)
+         break;
 
-      value_curr = m_Search.results[i].value_current;
-      value_prev = m_Search.results[i].value_previous;
+      value_curr = result.value_current;
+      value_prev = result.value_previous;
 
       /* Update previous value column */
       item = m_Table->item(i, m_ColValuePrev);
@@ -15,8 +15,13 @@ class CleResultTablePointer : public CleResultTable
 public:
   CleResultTablePointer(QWidget *parent, cl_addr_t address, cl_value_type value_type,
     unsigned passes, cl_addr_t range, cl_addr_t max_results);
+
+  /* Continues a pointer search from a scan file saved in an earlier session */
+  CleResultTablePointer(QWidget *parent, const QString& path);
   ~CleResultTablePointer() override;
 
+  bool loaded(void) const { return m_Loaded; }
+
   cl_addr_t getClickedResultAddress() override;
   void *searchData(void) override;
   int isInitted(void) override { return true; }
@@ -35,6 +40,7 @@ public:
 
 public slots:
   void onClickResultAddMemoryNote();
+  void onClickSaveScan();
   void onResultClick(QTableWidgetItem *item) override;
   void onResultDoubleClick(void) override;
   void onResultEdited(QTableWidgetItem *item) override;
@@ -47,6 +53,9 @@ signals:
   void requestRemove(uint32_t index);
 
 private:
+  void initTable(QWidget *parent, unsigned passes);
+
+  bool m_Loaded = false;
   unsigned m_ColAddress;
   unsigned m_ColValuePrev;
   unsigned m_ColValueCurr;
@@ -2,6 +2,7 @@
 
 extern "C"
 {
+  #include "../cl_memory.h"
   #include "../cl_network.h"
   #include "../cl_script.h"
 }
@@ -18,8 +19,9 @@ static void cle_script_upload_cb(cl_network_response_t response, void *ud)
     auto string = script->script().toStdString();
     const char *pos = string.c_str();
 
-    cl_script_free();
-    cl_script_init(&pos);
+    cl_script_free(&::script);
+    cl_memory_reset_references();
+    cl_script_init(&::script, &pos);
     script->rebuild();
     QMessageBox::information(nullptr, "Upload result",
                              "CL Script uploaded successfully!");